@@ -22,127 +22,78 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
-
-typedef struct _blockParser {
-    bool rereadSizes;
-    // Structural info
-    uint32_t numSizeEntries;
-    int32_t *blockSizes;
-    uint32_t sizeIndex;
-    // Exposed return info
-    uint32_t dataLen;
-    uint8_t *blockData;
-    // Version-specific return info
-    bool newSegmentFlag; // Versions 1-3, set to true when block is the first of its segment
-    uint32_t segmentLength; // Versions 1-3, set to total length of segment
-    
-    uint32_t sizesInBlock; // Version 4, set to the number of size entries making up the block, minus the magic number
-    int32_t blockBank; // Version 4, set to block's magic number (requires additional research)
-} blockParser;
-
-enum dsTextureFormat {
-    NO_TEXTURE,
-    A3I5,
-    PALETTE_2_BPP,
-    PALETTE_4_BPP,
-    PALETTE_8_BPP,
-    COMPRESSED,
-    A5I3,
-    DIRECT_TEXTURE
-};
-
-typedef struct _dsBTGAHeader {
-    uint32_t clobbered0;
-    uint32_t bodyLength;
-    uint32_t clobbered1;
-    uint32_t paletteLength;
-    uint32_t clobbered2;
-    uint32_t paletteIndexLength;
-    enum dsTextureFormat textureFormat;
-    uint8_t color0Transparent;
-    uint8_t hwidth;
-    uint8_t hheight;
-
-    // Values generated from header values
-    uint8_t bpp;
-    uint32_t hres; // 8 << hwidth
-    uint32_t vres; // 8 << hheight
-    uint8_t indexBits;
-    const uint8_t *alphaConvTable;
-} dsBTGAHeader;
-
-// Stores allocated buffers for easier cleanup
-typedef struct _ttfTGAFile {
-    uint8_t *bodySegment;
-    uint16_t *paletteSegment;
-    uint16_t *paletteIndexSegment;
-
-    blockParser *parser;
-} ttfTGAFile;
-
-// Lookup tables to convert color spaces to 8 bit depth
-const uint8_t colorConv5[32] = {0x00, 0x08, 0x10, 0x19, 0x21, 0x29, 0x31, 0x3A,
-                                0x42, 0x4A, 0x52, 0x5A, 0x63, 0x6B, 0x73, 0x7B,
-                                0x84, 0x8C, 0x94, 0x9C, 0xA5, 0xAD, 0xB5, 0xBD,
-                                0xC5, 0xCE, 0xD6, 0xDE, 0xE6, 0xEF, 0xF7, 0xFF};
-const uint8_t colorConv3[8]  = {0x00, 0x24, 0x49, 0x6D, 0x92, 0xB6, 0xDB, 0xFF};
-const uint8_t colorConv1[2]  = {0xFF, 0xFF}; // For alpha bit
-
-#define CONVRGB555(X) (0xFF000000 | (colorConv5[(X) & 0x001F] << 16) | \
-                        (colorConv5[((X) & 0x03E0) >> 5] << 8) | \
-                        (colorConv5[((X) & 0x7C00) >> 10]))
-
-#define CONVRGBA5551(X) ((colorConv1[(X) >> 15] << 24) | (colorConv5[(X) & 0x001F] << 16) | \
-                        (colorConv5[((X) & 0x03E0) >> 5] << 8) | \
-                        (colorConv5[((X) & 0x7C00) >> 10]))
-
-bool readV1Block(blockParser *parser, FILE *inFile, long fileLength);
-bool readV3Block(blockParser *parser, FILE *inFile, long fileLength);
-bool readV4Block(blockParser *parser, FILE *inFile, long fileLength);
-
-void freeAll(ttfTGAFile *buffers);
-
-// Verifies if current block is a valid BTGA header. Frees block before returning on success
-bool processHeader(blockParser *source, dsBTGAHeader *header);
-
-uint8_t verifyColors(uint8_t *bodyData, dsBTGAHeader *header);
-uint8_t verifyPalettes(uint16_t *indexData, dsBTGAHeader *header);
-
-uint32_t *genBasePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent);
-uint32_t *genA5I3Palette(uint32_t *basePalette, uint8_t numColors);
-uint32_t *genA3I5Palette(uint32_t *basePalette, uint8_t numColors);
-uint32_t blend888(const uint32_t color0, const uint32_t color1, const int mix0, const int mix1);
-
-uint32_t *convBodyDataDC(uint16_t *bodyData, uint32_t res);
-uint32_t *convBodyDataPalette(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp);
-uint32_t *convBodyDataCompressed(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header);
-
-char *tryTGAConv(char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset);
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "fib.h"
+#include "fibReader.h"
+#include "lruCache.h"
+#include "ttfContainer.h"
+#include "dsTexture.h"
+#include "paletteCache.h"
+
+// Built palettes kept for reuse across textures
+#define PALETTE_CACHE_BYTES (4 << 20)
+
+// Daemon connection limits. Connections past MAX_CLIENTS are closed straight away, and so are clients that send
+// a line longer than any valid request.
+#define MAX_CLIENTS 64
+#define MAX_REQUEST_LENGTH (2 * PATH_MAX + 64)
+
+// Decompressed fibfile chunks kept per opened fibfile, so the chunk holding an entry's header is only
+// decompressed once. HEADER_PROBE_BYTES is how much of an entry is read to check for a BTGA header first.
+#define ARCHIVE_CHUNK_CACHE_BYTES (256 << 10)
+#define HEADER_PROBE_BYTES 0x200
+
+char *writeTGA(const char *outputPath, dsBTGAHeader *header, uint32_t *imageData);
+char *tryTGAConv(char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                 paletteCache *palettes);
+
+int serveRequests(const char *socketPath, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                  enum fibVersion fibVersion, size_t cacheBytes);
 
 int main(int argc, char *argv[]) {
-    if(argc != 3) {
-        printf("Format: dsConvBTGA version input_directory\n");
+    const bool serve = argc == 6 && !strcmp(argv[1], "serve");
+
+    if(argc != 3 && !serve) {
+        printf("Format: dsConvBTGA version input_directory\n"
+               "    or: dsConvBTGA serve version fib_version socket_path cache_MiB\n");
         return -1;
     }
 
-    long startOffset = 0;
+    long startOffset;
     bool (*readBlock)(blockParser *, FILE *, long);
 
-    if(!strcmp(argv[1], "1")) {
-        readBlock = &readV1Block;
-        startOffset = 0x0C;
-    } else if(!strcmp(argv[1], "2")) {
-        readBlock = &readV1Block;
-    } else if(!strcmp(argv[1], "3")) {
-        readBlock = &readV3Block;
-    } else if(!strcmp(argv[1], "4")) {
-        readBlock = &readV4Block;
-    } else {
+    if(!selectBlockReader(serve ? argv[2] : argv[1], &readBlock, &startOffset)) {
         printf("Format: ./dsConvBTGA version input_directory\n"
                "Where version is one of 1, 2, 3, or 4\n");
         return -1;
     }
 
+    if(serve) {
+        enum fibVersion fibVersion;
+
+        if(!fibParseVersion(argv[3], &fibVersion)) {
+            printf("Where fib_version is one of 1, 2, 2.5, 3, or 3.5\n");
+            return -1;
+        }
+
+        long cacheMiB = strtol(argv[5], NULL, 10);
+
+        if(cacheMiB <= 0) {
+            printf("Cache size must be a positive number of MiB\n");
+            return -1;
+        }
+
+        return serveRequests(argv[4], readBlock, startOffset, fibVersion, (size_t) cacheMiB << 20);
+    }
+
     DIR *inputDir = opendir(argv[2]);
 
     if(!inputDir) {
@@ -156,6 +107,13 @@ int main(int argc, char *argv[]) {
 
     int successCount = 0;
 
+    paletteCache palettes;
+
+    if(!paletteCacheInit(&palettes, PALETTE_CACHE_BYTES)) {
+        closedir(inputDir);
+        return -1;
+    }
+
     while(1) {
         currentEntry = readdir(inputDir);
 
@@ -171,7 +129,7 @@ int main(int argc, char *argv[]) {
         strcat(subfilePath, "/");
         strcat(subfilePath, currentEntry->d_name);
 
-        if(!tryTGAConv(subfilePath, readBlock, startOffset)) {
+        if(!tryTGAConv(subfilePath, readBlock, startOffset, &palettes)) {
             successCount++;
         }
 
@@ -179,680 +137,613 @@ int main(int argc, char *argv[]) {
     }
 
     closedir(inputDir);
+    paletteCacheDestroy(&palettes);
 
     printf("Successfully converted %i files\n", successCount);
 
     return 0;
 }
 
-bool readV1Block(blockParser *parser, FILE *inFile, long fileLength) {
-    if(parser->rereadSizes) {
-        long currentPos = ftell(inFile);
-
-        if(currentPos + 0x08 > fileLength) {
-            return false;
-        }
+char *writeTGA(const char *outputPath, dsBTGAHeader *header, uint32_t *imageData) {
+    FILE *outFile = fopen(outputPath, "wb");
 
-        uint16_t numBlocks;
+    if(!outFile) {
+        return "Failed to open output file!\n";
+    }
 
-        size_t readLen = fread(&numBlocks, 0x02, 0x01, inFile);
+    fputc(0, outFile);
+    fputc(0, outFile);
+    fputc(2, outFile);
 
-        if(readLen != 0x01 || !numBlocks) {
-            return false;
-        }
+    fputc(0, outFile);
+    fputc(0, outFile);
+    fputc(0, outFile);
+    fputc(0, outFile);
+    fputc(0, outFile);
 
-        parser->numSizeEntries = numBlocks;
-        fseek(inFile, 2, SEEK_CUR);
+    fputc(0, outFile);
+    fputc(0, outFile);
 
-        readLen = fread(&parser->segmentLength, 0x04, 0x01, inFile);
+    fputc(0, outFile);
+    fputc(0, outFile);
 
-        if(readLen != 0x01 || !parser->segmentLength ||
-            currentPos + 0x08 + parser->numSizeEntries * 4 + parser->segmentLength > fileLength) {
-            return false;
-        }
+    fwrite(&header->hres, 2, 1, outFile);
+    fwrite(&header->vres, 2, 1, outFile);
+    
+    fputc(32, outFile);
+    fputc(0b00111000, outFile);
 
-        parser->blockSizes = malloc(parser->numSizeEntries * 4);
+    fwrite(imageData, 4, header->hres * header->vres, outFile);
 
-        fread(parser->blockSizes, 4, parser->numSizeEntries, inFile);
+    fclose(outFile);
 
-        uint32_t totalLen = 0;
-        for(int i = 0; i < parser->numSizeEntries; i++) {
-            totalLen += parser->blockSizes[i];
-        }
+    return NULL;
+}
 
-        if(totalLen != parser->segmentLength) {
-            free(parser->blockSizes);
-            parser->blockSizes = NULL;
-            parser->blockData = NULL;
-            return false;
-        }
+char *tryTGAConv(char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                 paletteCache *palettes) {
+    FILE *inputFile = fopen(path, "rb");
 
-        parser->sizeIndex = 0;
-        parser->newSegmentFlag = true;
-        parser->rereadSizes = false;
-    } else {
-        parser->newSegmentFlag = false;
+    if(!inputFile) {
+        return "Couldn't open input file!\n";
     }
 
-    parser->dataLen = parser->blockSizes[parser->sizeIndex];
-    parser->blockData = malloc(parser->dataLen);
-    
-    if(!fread(parser->blockData, parser->dataLen, 1, inFile)) {
-        free(parser->blockData);
-        free(parser->blockSizes);
-        parser->blockData = NULL;
-        parser->blockSizes = NULL;
-        return false;
-    }
+    dsBTGAHeader header;
+    uint32_t *imageData;
+
+    char *error = decodeTGA(inputFile, readBlock, startOffset, palettes, &header, &imageData);
 
-    parser->sizeIndex++;
-    if(parser->sizeIndex == parser->numSizeEntries) {
-        free(parser->blockSizes);
-        parser->blockSizes = NULL;
-        parser->rereadSizes = true;
+    if(error) {
+        return error;
     }
 
-    return true;
-}
+    int pathLen = strlen(path);
 
-bool readV3Block(blockParser *parser, FILE *inFile, long fileLength) {
-    unsigned long filePos = ftell(inFile);
-    int redirections = 0;
+    char *outputPath = malloc(pathLen + 5);
+    strcpy(outputPath, path);
+    strcat(outputPath, ".tga");
 
-    parser->newSegmentFlag = parser->rereadSizes;
+    error = writeTGA(outputPath, &header, imageData);
 
-    while(parser->rereadSizes) {
-        if(redirections > 5 || filePos + 8 > fileLength) {
-            return false;
-        }
+    free(outputPath);
+    free(imageData);
 
-        uint32_t headerInfo[2];
-        if(!fread(&headerInfo, 8, 1, inFile)) {
-            return false;
-        }
-        filePos += 8;
+    return error;
+}
 
-        if(headerInfo[0] & 0xFF) {
-            fseek(inFile, headerInfo[1], SEEK_CUR);
-            filePos += headerInfo[1];
-            redirections++;
-            continue;
-        }
+// Daemon mode. Requests are single lines of tab separated fields on a Unix stream socket:
+//     FILE<TAB>btga_path
+//     HASH<TAB>fib_path<TAB>hex_hash
+//     NAME<TAB>fib_path<TAB>path_within_fib
+// Successful replies are "OK hres vres\n" followed by hres * vres BGRA pixels, failures are "ERR message\n".
+// Decoded images and opened fibfiles share one LRU cache, bounded by their heap footprint.
+enum cachedType {
+    CACHED_IMAGE,
+    CACHED_ARCHIVE
+};
 
-        parser->numSizeEntries = headerInfo[0] >> 16;
-        parser->segmentLength = headerInfo[1];
+typedef struct _cachedValue {
+    enum cachedType type;
+    // Source file identity, so files changed on disk aren't served stale
+    struct timespec mtime;
+    off_t fileSize;
 
-        if(filePos + parser->numSizeEntries * 4 + parser->segmentLength > fileLength) {
-            return false;
-        }
+    dsBTGAHeader header;
+    uint32_t *imageData;
 
-        parser->blockSizes = malloc(parser->numSizeEntries * 4);
-        fread(parser->blockSizes, 4, parser->numSizeEntries, inFile);
+    fibArchive archive;
+    fibReader reader;
+} cachedValue;
 
-        uint32_t totalLen = 0;
-        for(int i = 0; i < parser->numSizeEntries; i++) {
-            totalLen += parser->blockSizes[i];
-        }
+// Bytes received from a client that don't make up a whole request yet
+typedef struct _clientConnection {
+    int fd;
+    char buffer[MAX_REQUEST_LENGTH];
+    size_t length;
+} clientConnection;
 
-        if(totalLen != parser->segmentLength) {
-            free(parser->blockSizes);
-            parser->blockSizes = NULL;
-            parser->blockData = NULL;
-            return false;
-        }
+static volatile sig_atomic_t stopServing = 0;
 
-        parser->sizeIndex = 0;
-        parser->rereadSizes = false;
-    }
+static void handleStopSignal(int signalNumber) {
+    (void) signalNumber;
+    stopServing = 1;
+}
 
-    parser->dataLen = parser->blockSizes[parser->sizeIndex];
-    parser->blockData = malloc(parser->dataLen);
-    
-    if(!fread(parser->blockData, parser->dataLen, 1, inFile)) {
-        free(parser->blockData);
-        free(parser->blockSizes);
-        parser->blockData = NULL;
-        parser->blockSizes = NULL;
-        return false;
-    }
+static void freeCachedValue(void *value) {
+    cachedValue *cached = value;
 
-    parser->sizeIndex++;
-    if(parser->sizeIndex == parser->numSizeEntries) {
-        free(parser->blockSizes);
-        parser->blockSizes = NULL;
-        parser->rereadSizes = true;
+    if(cached->type == CACHED_IMAGE) {
+        free(cached->imageData);
+    } else {
+        fibReaderDestroy(&cached->reader);
+        fibClose(&cached->archive);
     }
 
-    return true;
+    free(cached);
 }
 
-bool readV4Block(blockParser *parser, FILE *inFile, long fileLength) {
-    unsigned long filePos = ftell(inFile);
-    int redirections = 0;
-
-    while(parser->rereadSizes) {
-        if(redirections > 5 || filePos + 8 > fileLength) {
-            return false;
-        }
+static bool sameFile(const cachedValue *cached, const struct stat *fileInfo) {
+    return cached->fileSize == fileInfo->st_size && cached->mtime.tv_sec == fileInfo->st_mtim.tv_sec &&
+           cached->mtime.tv_nsec == fileInfo->st_mtim.tv_nsec;
+}
 
-        uint32_t headerInfo[2];
-        if(!fread(&headerInfo, 8, 1, inFile)) {
-            return false;
-        }
-        filePos += 8;
+static bool writeAll(int fd, const void *data, size_t length) {
+    const uint8_t *bytes = data;
 
-        if(headerInfo[0] & 0xFF) {
-            fseek(inFile, headerInfo[1], SEEK_CUR);
-            filePos += headerInfo[1];
-            redirections++;
-            continue;
-        }
+    while(length) {
+        ssize_t written = write(fd, bytes, length);
 
-        parser->numSizeEntries = headerInfo[0] >> 8;
-        uint32_t blockSizesLength = headerInfo[1];
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
 
-        if(parser->numSizeEntries * 4 != blockSizesLength || filePos + parser->numSizeEntries * 4 > fileLength) {
             return false;
         }
 
-        parser->blockSizes = malloc(blockSizesLength);
-        fread(parser->blockSizes, blockSizesLength, 1, inFile);
-        filePos += blockSizesLength;
-        parser->sizeIndex = 0;
-        parser->rereadSizes = false;
+        bytes += written;
+        length -= written;
     }
 
-    if(parser->sizeIndex >= parser->numSizeEntries) {
-        free(parser->blockSizes);
-        parser->blockSizes = NULL;
-        return false;
-    }
+    return true;
+}
 
-    int32_t blockMagic = parser->blockSizes[parser->sizeIndex];
-    parser->sizeIndex++;
-    if(blockMagic < -0x10 || blockMagic > -0x0E) {
-        free(parser->blockSizes);
-        return false;
-    }
+static bool sendImage(int fd, const cachedValue *image) {
+    char status[32];
+    int statusLength = snprintf(status, sizeof(status), "OK %u %u\n", image->header.hres, image->header.vres);
 
-    parser->sizesInBlock = 0;
-    parser->dataLen = 0;
+    return writeAll(fd, status, statusLength) &&
+           writeAll(fd, image->imageData, (size_t) image->header.hres * image->header.vres * 4);
+}
 
-    while(parser->sizeIndex < parser->numSizeEntries) {
-        int32_t blockSize = parser->blockSizes[parser->sizeIndex];
-        if(blockSize >= -0x10 && blockSize <= -0x0E) {
-            break;
-        }
-        parser->sizesInBlock++;
-        parser->dataLen += blockSize;
-        parser->sizeIndex++;
+static bool sendError(int fd, const char *error) {
+    return writeAll(fd, "ERR ", 4) && writeAll(fd, error, strlen(error));
+}
+
+// Key is a type tag, the path, and for fibfile entries a null separator followed by what the entry was found by:
+// its hash for hashed filetable entries ('H'), or its path for named filetable entries ('N')
+static size_t buildCacheKey(char *key, size_t keyCapacity, char tag, const char *path, const void *entryKey,
+                            size_t entryKeyLength) {
+    size_t pathLength = strlen(path);
+    size_t keyLength = 1 + pathLength + (entryKey ? 1 + entryKeyLength : 0);
+
+    if(keyLength > keyCapacity) {
+        return 0;
     }
 
-    if(filePos + parser->dataLen > fileLength) {
-        free(parser->blockSizes);
-        return false;
+    key[0] = tag;
+    memcpy(key + 1, path, pathLength);
+
+    if(entryKey) {
+        key[1 + pathLength] = '\0';
+        memcpy(key + 2 + pathLength, entryKey, entryKeyLength);
     }
 
-    parser->blockData = malloc(parser->dataLen);
-    fread(parser->blockData, parser->dataLen, 1, inFile);
-    return true;
+    return keyLength;
 }
 
-void freeAll(ttfTGAFile *buffers) {
-    free(buffers->bodySegment);
-    free(buffers->paletteSegment);
-    free(buffers->paletteIndexSegment);
+static cachedValue *newImage(const struct stat *fileInfo, dsBTGAHeader *header, uint32_t *imageData) {
+    cachedValue *image = calloc(1, sizeof(cachedValue));
+
+    image->type = CACHED_IMAGE;
+    image->mtime = fileInfo->st_mtim;
+    image->fileSize = fileInfo->st_size;
+    image->header = *header;
+    image->imageData = imageData;
 
-    free(buffers->parser->blockSizes);
-    free(buffers->parser->blockData);
+    return image;
 }
 
-bool processHeader(blockParser *source, dsBTGAHeader *header) {
-    if(source->dataLen != 0x1C) {
-        return false;
+// Checks the start of a fibfile entry for a BTGA header, so entries that aren't textures are turned away without
+// decompressing the rest. entryData has room for the whole entry, but only its first prefixLength bytes are read.
+// Container parsers only ever move forward, so a parse that ends within the prefix saw nothing else, and its
+// result holds for the whole entry. Anything else is left for decodeTGA to judge.
+static char *probeHeader(uint8_t *entryData, uint32_t prefixLength, uint32_t entryLength,
+                         bool (*readBlock)(blockParser *, FILE *, long), long startOffset) {
+    if(entryLength < 0x28) {
+        return "Requested file is too short to possibly be a TTF TGA!\n";
     }
 
-    uint8_t formatByte;
-    
-    memcpy(&header->clobbered0, source->blockData, 4);
-    memcpy(&header->bodyLength, source->blockData + 0x04, 4);
-    memcpy(&header->clobbered1, source->blockData + 0x08, 4);
-    memcpy(&header->paletteLength, source->blockData + 0x0C, 4);
-    memcpy(&header->clobbered2, source->blockData + 0x10, 4);
-    memcpy(&header->paletteIndexLength, source->blockData + 0x14, 4);
-    memcpy(&formatByte, source->blockData + 0x18, 1);
-    header->textureFormat = formatByte;
-    memcpy(&header->color0Transparent, source->blockData + 0x19, 1);
-    memcpy(&header->hwidth, source->blockData + 0x1A, 1);
-    memcpy(&header->hheight, source->blockData + 0x1B, 1);
-
-    // Paletted texture missing palette
-    if(!header->paletteLength && header->textureFormat != 0x07) {
-        return false;
-    }
+    FILE *entryFile = fmemopen(entryData, entryLength, "rb");
 
-    // Compressed texture missing segment
-    if(!header->paletteIndexLength && header->textureFormat == 0x05) {
-        return false;
+    if(!entryFile) {
+        return NULL;
     }
 
-    switch(header->textureFormat) {
-        case NO_TEXTURE:
-            return false;
-            break;
-        case A3I5:
-            header->bpp = 8;
-            header->indexBits = 5;
-            header->alphaConvTable = colorConv3;
-            break;
-        case PALETTE_2_BPP:
-            header->bpp = 2;
-            header->indexBits = 2;
-            break;
-        case PALETTE_4_BPP:
-            header->bpp = 4;
-            header->indexBits = 4;
-            break;
-        case PALETTE_8_BPP:
-            header->bpp = 8;
-            header->indexBits = 8;
-            break;
-        case COMPRESSED:
-            if(header->paletteIndexLength != header->bodyLength / 2) {
-                return false;
-            }
+    fseek(entryFile, startOffset, SEEK_SET);
 
-            header->bpp = 2;
-            break;
-        case A5I3:
-            header->bpp = 8;
-            header->indexBits = 3;
-            header->alphaConvTable = colorConv5;
-            break;
-        case DIRECT_TEXTURE:
-            header->bpp = 16;
-            break;
-        default:
-            return false;
-    }
+    blockParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.rereadSizes = true;
 
-    header->hres = 8 << (header->hwidth & 0x07);
-    header->vres = 8 << (header->hheight & 0x07);
+    dsBTGAHeader header;
+    char *error = NULL;
+    const bool headerRead = readBlock(&parser, entryFile, entryLength);
 
-    // Body length not matching resolution
-    if(header->hres * header->vres * header->bpp != header->bodyLength * 8) {
-        return NULL;
+    if(ftell(entryFile) <= prefixLength) {
+        if(!headerRead) {
+            error = "Malformed header segment descriptor!\n";
+        } else if(!processHeader(&parser, &header)) {
+            error = "Issue relating to header!\n";
+        }
     }
 
-    free(source->blockData);
-    source->blockData = NULL;
+    if(headerRead) {
+        free(parser.blockSizes);
+        free(parser.blockData);
+    }
 
-    return header;
-}
+    fclose(entryFile);
 
-// Return 0 if an invalid palette index is used
-uint8_t verifyColors(uint8_t *bodyData, dsBTGAHeader *header) {
-    const uint8_t indexMask = (1 << header->indexBits) - 1;
-    const uint8_t bpp = header->bpp;
-    const uint8_t ppB = 4 >> (bpp >> 2);
-    const uint32_t bodyBytes = header->bodyLength;
-    const uint32_t colors = header->paletteLength / 2;
+    return error;
+}
 
-    for(int i = 0; i < bodyBytes; i++) {
-        uint8_t currByte = bodyData[i];
+// Replies to the request, returning false if the client went away
+static bool handleRequest(int clientFd, char *request, lruCache *cache, paletteCache *palettes,
+                          bool (*readBlock)(blockParser *, FILE *, long), long startOffset, enum fibVersion fibVersion) {
+    char *fields[3];
+    int numFields = 0;
 
-        for(int j = 0; j < ppB; j++) {
-            if((currByte & indexMask) >= colors) {
-                return 0;
-            }
-            
-            currByte >>= bpp;
-        }
+    for(char *field = strtok(request, "\t"); field && numFields < 3; field = strtok(NULL, "\t")) {
+        fields[numFields++] = field;
     }
 
-    return 1;
-}
+    if(numFields < 2) {
+        return sendError(clientFd, "Malformed request!\n");
+    }
 
-// Return 0 if a compressed texture's palette indexing table points to an invalid palette 
-uint8_t verifyPalettes(uint16_t *indexData, dsBTGAHeader *header) {
-    const uint32_t indexEntries = header->paletteIndexLength / 2;
+    char key[2 * PATH_MAX + 8];
+    size_t keyLength;
+    struct stat fileInfo;
+    dsBTGAHeader header;
+    uint32_t *imageData;
 
-    for(int i = 0; i < indexEntries; i++) {
-        if((indexData[i] & 0x3FFF) * 4 > header->paletteLength) {
-            return 0;
+    if(!strcmp(fields[0], "FILE") && numFields == 2) {
+        if(stat(fields[1], &fileInfo)) {
+            return sendError(clientFd, "Couldn't open input file!\n");
         }
-    }
 
-    return 1;
-}
+        keyLength = buildCacheKey(key, sizeof(key), 'F', fields[1], NULL, 0);
 
-// Convert 16-bit DS palettes to true color BGRA
-uint32_t *genBasePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent) {
-    int paletteSize = length / 2;
+        if(!keyLength) {
+            return sendError(clientFd, "Path too long!\n");
+        }
 
-    uint32_t *palette = malloc(paletteSize * 4);
+        cachedValue *image = lruGet(cache, key, keyLength);
 
-    if(color0Transparent) {
-        palette[0] = CONVRGB555(source[0]) & 0x00FFFFFF;
-    } else {
-        palette[0] = CONVRGB555(source[0]);
-    }
+        if(image && sameFile(image, &fileInfo)) {
+            return sendImage(clientFd, image);
+        }
 
-    for(int i = 1; i < paletteSize; i++) {
-        palette[i] = CONVRGB555(source[i]);
-    }
+        FILE *inputFile = fopen(fields[1], "rb");
 
-    return palette;
-}
+        if(!inputFile) {
+            return sendError(clientFd, "Couldn't open input file!\n");
+        }
 
-uint32_t *genA5I3Palette(uint32_t *basePalette, uint8_t numColors) {
-    uint32_t *fullPalette = malloc(sizeof(uint32_t) * 256);
+        char *error = decodeTGA(inputFile, readBlock, startOffset, palettes, &header, &imageData);
 
-    if(numColors > 8) {
-        numColors = 8;
-    }
+        if(error) {
+            lruRemove(cache, key, keyLength);
+            return sendError(clientFd, error);
+        }
 
-    basePalette[0] |= 0xFF000000;
+        image = newImage(&fileInfo, &header, imageData);
+        bool sent = sendImage(clientFd, image);
 
-    for(int i = 0; i < numColors; i++) {
-        const uint32_t baseColor = basePalette[i];
-        for(int j = 0; j < 32; j++) {
-            fullPalette[i + j * 8] = baseColor & ((colorConv5[j] << 24) | 0x00FFFFFF);
+        if(!lruPut(cache, key, keyLength, image, sizeof(cachedValue) + (size_t) header.hres * header.vres * 4)) {
+            freeCachedValue(image);
         }
-    }
 
-    free(basePalette);
-
-    return fullPalette;
-}
+        return sent;
+    }
 
-uint32_t *genA3I5Palette(uint32_t *basePalette, uint8_t numColors) {
-    uint32_t *fullPalette = malloc(sizeof(uint32_t) * 256);
+    if((strcmp(fields[0], "HASH") && strcmp(fields[0], "NAME")) || numFields != 3) {
+        return sendError(clientFd, "Malformed request!\n");
+    }
 
-    if(numColors > 32) {
-        numColors = 32;
+    if(stat(fields[1], &fileInfo)) {
+        return sendError(clientFd, "Couldn't open fibfile!\n");
     }
 
-    basePalette[0] |= 0xFF000000;
+    keyLength = buildCacheKey(key, sizeof(key), 'A', fields[1], NULL, 0);
 
-    for(int i = 0; i < numColors; i++) {
-        const uint32_t baseColor = basePalette[i];
-        for(int j = 0; j < 8; j++) {
-            fullPalette[i + j * 32] = baseColor & ((colorConv5[j * 4 + j / 2] << 24) | 0x00FFFFFF);
-        }
+    if(!keyLength) {
+        return sendError(clientFd, "Path too long!\n");
     }
 
-    free(basePalette);
+    cachedValue *archiveValue = lruGet(cache, key, keyLength);
+    bool archiveCached = true;
 
-    return fullPalette;
-}
+    if(!archiveValue || !sameFile(archiveValue, &fileInfo)) {
+        archiveValue = calloc(1, sizeof(cachedValue));
+        archiveValue->type = CACHED_ARCHIVE;
+        archiveValue->mtime = fileInfo.st_mtim;
+        archiveValue->fileSize = fileInfo.st_size;
 
-uint32_t blend888(const uint32_t color0, const uint32_t color1, const int mix0, const int mix1) {
-    const int mixTotal = mix0 + mix1;
-    const uint32_t componentOne = (((color0 >> 16) & 0xFF) * mix0 + ((color1 >> 16) & 0xFF) * mix1) / mixTotal;
-    const uint32_t componentTwo = (((color0 >> 8) & 0xFF) * mix0 + ((color1 >> 8) & 0xFF) * mix1) / mixTotal;
-    const uint32_t componentThree = ((color0 & 0xFF) * mix0 + (color1 & 0xFF) * mix1) / mixTotal;
+        if(!fibOpen(&archiveValue->archive, fields[1], fibVersion)) {
+            free(archiveValue);
+            lruRemove(cache, key, keyLength);
+            return sendError(clientFd, "Couldn't open fibfile!\n");
+        }
 
-    return (componentOne << 16) | (componentTwo << 8) | componentThree;
-}
+        if(!fibReaderInit(&archiveValue->reader, &archiveValue->archive, ARCHIVE_CHUNK_CACHE_BYTES)) {
+            fibClose(&archiveValue->archive);
+            free(archiveValue);
+            lruRemove(cache, key, keyLength);
+            return sendError(clientFd, "Couldn't open fibfile!\n");
+        }
 
-uint32_t *convBodyDataDC(uint16_t *bodyData, uint32_t res) {
-    uint32_t *imageData = malloc(sizeof(uint32_t) * res);
+        const fibArchive *archive = &archiveValue->archive;
+        const size_t totalEntries = (size_t) archive->hashedEntries + archive->namedEntries;
+        size_t archiveCost = sizeof(cachedValue) + totalEntries * (sizeof(fibEntry) + sizeof(fibChunk *) + 4) +
+                             archive->namedEntries * sizeof(char *) + ARCHIVE_CHUNK_CACHE_BYTES;
 
-    for(int i = 0; i < res; i++) {
-        imageData[i] = CONVRGBA5551(bodyData[i]);
+        archiveCached = lruPut(cache, key, keyLength, archiveValue, archiveCost);
     }
 
-    return imageData;
-}
-
-uint32_t *convBodyDataPalette(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp) {
-    uint32_t *imageData = malloc(sizeof(uint32_t) * res);
+    fibArchive *archive = &archiveValue->archive;
+    uint32_t hash;
 
-    const uint8_t pixelMask = (1 << bpp) - 1;
-    const uint8_t ppB = 4 >> (bpp >> 2);
-    const uint32_t bodyBytes = res >> (ppB >> 1);
+    if(!strcmp(fields[0], "HASH")) {
+        char *end;
+        errno = 0;
+        const unsigned long parsedHash = strtoul(fields[2], &end, 16);
+        hash = parsedHash;
 
-    for(int i = 0; i < bodyBytes; i++) {
-        uint8_t currByte = bodyData[i];
+        // Longer hashes would otherwise be cut down to 32 bits and resolve to an unrelated entry
+        if(!fields[2][0] || *end || errno == ERANGE || parsedHash > UINT32_MAX) {
+            if(!archiveCached) {
+                freeCachedValue(archiveValue);
+            }
 
-        for(int j = 0; j < ppB; j++) {
-            imageData[i * ppB + j] = palette[currByte & pixelMask];
-            currByte >>= bpp;
+            return sendError(clientFd, "Malformed hash!\n");
         }
+    } else {
+        hash = fibHashPath(fields[2]);
     }
 
-    return imageData;
-}
+    const fibEntry *entry = strcmp(fields[0], "NAME") ? fibFindHash(archive, hash) : fibFindPath(archive, fields[2]);
 
-uint32_t *convBodyDataCompressed(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header) {
-    const uint32_t blocks = header->bodyLength / 4;
-    const uint32_t width = header->hres;
-    const uint32_t hBlocks = width / 4;
-    uint32_t *imageData = malloc(sizeof(uint32_t) * width * header->vres);
-
-    uint32_t blockPalette[4];
-
-    for(int i = 0; i < blocks; i++) {
-        uint32_t blockData = bodyData[i];
-        uint16_t indexData = indexTable[i];
-        const uint32_t *paletteBase = palette + (indexData & 0x3FFF) * 2;
-
-        blockPalette[0] = paletteBase[0];
-        blockPalette[1] = paletteBase[1];
-
-        switch(indexData >> 14) {
-            case 0:
-                blockPalette[2] = paletteBase[2];
-                blockPalette[3] = 0;
-                break;
-            case 1:
-                blockPalette[2] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 1, 1);
-                blockPalette[3] = 0;
-                break;
-            case 2:
-                blockPalette[2] = paletteBase[2];
-                blockPalette[3] = paletteBase[3];
-                break;
-            case 3:
-                blockPalette[2] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 5, 3);
-                blockPalette[3] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 3, 5);
-                break;
-        }
+    // NAME requests can resolve through the named filetable, which has to be cached apart from the same hash
+    if(entry && entry >= archive->namedTable && entry < archive->namedTable + archive->namedEntries) {
+        keyLength = buildCacheKey(key, sizeof(key), 'N', fields[1], fields[2], strlen(fields[2]));
+    } else {
+        keyLength = buildCacheKey(key, sizeof(key), 'H', fields[1], &hash, 4);
+    }
 
-        for(int j = 0; j < 4; j++) {
-            for(int k = 0; k < 4; k++) {
-                imageData[((i / hBlocks) * width * 4) + ((i % hBlocks) * 4) + j * width + k] = blockPalette[blockData & 0x03];
-                blockData >>= 2;
-            }
+    if(!keyLength) {
+        if(!archiveCached) {
+            freeCachedValue(archiveValue);
         }
+
+        return sendError(clientFd, "Path too long!\n");
     }
 
-    return imageData;
-}
+    cachedValue *image = lruGet(cache, key, keyLength);
 
-char *tryTGAConv(char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset) {
-    FILE *inputFile = fopen(path, "rb");
+    if(image && sameFile(image, &fileInfo)) {
+        if(!archiveCached) {
+            freeCachedValue(archiveValue);
+        }
 
-    if(!inputFile) {
-        return "Couldn't open input file!\n";
+        return sendImage(clientFd, image);
     }
 
-    fseek(inputFile, 0, SEEK_END);
-    long fileLength = ftell(inputFile);
-    fseek(inputFile, startOffset, SEEK_SET);
+    char *error = NULL;
 
-    // Minimum header length
-    if(fileLength < 0x28) {
-        fclose(inputFile);
-        return "Requested file is too short to possibly be a TTF TGA!\n";
-    }
+    if(!entry) {
+        error = "No such entry in fibfile!\n";
+    } else {
+        uint32_t entryLength = fibEntrySize(archive, entry);
+        uint32_t prefixLength;
+        uint8_t *entryData = malloc(entryLength ? entryLength : 1);
+
+        if(!entryData || !fibRead(&archiveValue->reader, entry, 0, HEADER_PROBE_BYTES, entryData, &prefixLength)) {
+            error = "Couldn't decompress fibfile entry!\n";
+        } else if(!(error = probeHeader(entryData, prefixLength, entryLength, readBlock, startOffset))) {
+            uint32_t restLength;
+
+            // The rest of the chunk the probe ended in is still cached by the reader
+            if(!fibRead(&archiveValue->reader, entry, prefixLength, entryLength - prefixLength,
+                        entryData + prefixLength, &restLength)) {
+                error = "Couldn't decompress fibfile entry!\n";
+            } else {
+                FILE *inputFile = fmemopen(entryData, entryLength, "rb");
+
+                if(!inputFile) {
+                    error = "Couldn't open fibfile entry!\n";
+                } else {
+                    error = decodeTGA(inputFile, readBlock, startOffset, palettes, &header, &imageData);
+                }
+            }
+        }
 
-    ttfTGAFile fileInfo;
-    memset(&fileInfo, 0, sizeof(fileInfo));
+        free(entryData);
+    }
 
-    blockParser parser;
-    parser.blockSizes = NULL;
-    parser.rereadSizes = true;
-    fileInfo.parser = &parser;
+    // Nothing below touches the archive, and caching the image may evict it
+    if(!archiveCached) {
+        freeCachedValue(archiveValue);
+    }
 
-    if(!readBlock(&parser, inputFile, fileLength)) {
-        fclose(inputFile);
-        return "Malformed header segment descriptor!\n";
+    if(error) {
+        lruRemove(cache, key, keyLength);
+        return sendError(clientFd, error);
     }
 
-    dsBTGAHeader header;
+    image = newImage(&fileInfo, &header, imageData);
+    bool sent = sendImage(clientFd, image);
 
-    if(!processHeader(&parser, &header)) {
-        freeAll(&fileInfo);
-        fclose(inputFile);
-        return "Issue relating to header!\n";
+    if(!lruPut(cache, key, keyLength, image, sizeof(cachedValue) + (size_t) header.hres * header.vres * 4)) {
+        freeCachedValue(image);
     }
 
-    if(!readBlock(&parser, inputFile, fileLength)) {
-        freeAll(&fileInfo);
-        fclose(inputFile);
-        return "Malformed body segment descriptor!\n";
+    return sent;
+}
+
+// Reads whatever the client has sent and replies to each complete request in it.
+// Returns false once the client has gone away, or sent a request too long to be valid.
+static bool readRequests(clientConnection *client, lruCache *cache, paletteCache *palettes,
+                         bool (*readBlock)(blockParser *, FILE *, long), long startOffset, enum fibVersion fibVersion) {
+    ssize_t received = read(client->fd, client->buffer + client->length, MAX_REQUEST_LENGTH - client->length);
+
+    if(received < 0) {
+        return errno == EINTR;
     }
 
-    fileInfo.bodySegment = parser.blockData;
-    parser.blockData = NULL;
+    // A final request without a newline is still answered
+    if(!received && client->length) {
+        client->buffer[client->length] = '\n';
+        received = 1;
+    }
 
-    if(parser.dataLen != header.bodyLength) {
-        freeAll(&fileInfo);
-        fclose(inputFile);
-        return "Body's length does not match what is reported in header!\n";
+    if(!received) {
+        return false;
     }
 
-    uint32_t *imageData;
-    uint32_t totalRes = header.hres * header.vres;
-
-    if(header.textureFormat == DIRECT_TEXTURE) {
-        fclose(inputFile);
-        imageData = convBodyDataDC((uint16_t *) fileInfo.bodySegment, totalRes);
-    } else if(header.textureFormat == COMPRESSED) {
-        if(!readBlock(&parser, inputFile, fileLength)) {
-            freeAll(&fileInfo);
-            fclose(inputFile);
-            return "Malformed palette segment descriptor!\n";
-        }
+    client->length += received;
 
-        fileInfo.paletteSegment = (uint16_t *) parser.blockData;
-        parser.blockData = NULL;
+    char *request = client->buffer;
+    char *end;
 
-        if(parser.dataLen != header.paletteLength) {
-            freeAll(&fileInfo);
-            fclose(inputFile);
-            return "Palette's length does not match what is reported in header!\n";
-        }
+    while((end = memchr(request, '\n', client->buffer + client->length - request))) {
+        *end = '\0';
 
-        if(!readBlock(&parser, inputFile, fileLength)) {
-            freeAll(&fileInfo);
-            fclose(inputFile);
-            return "Malformed palette index segment descriptor!\n";
+        if(!handleRequest(client->fd, request, cache, palettes, readBlock, startOffset, fibVersion)) {
+            return false;
         }
 
-        fclose(inputFile);
+        request = end + 1;
+    }
 
-        fileInfo.paletteIndexSegment = (uint16_t *) parser.blockData;
-        parser.blockData = NULL;
+    client->length -= request - client->buffer;
+    memmove(client->buffer, request, client->length);
 
-        if(parser.dataLen != header.paletteIndexLength) {
-            freeAll(&fileInfo);
-            return "Palette index's length does not match what is reported in header!\n";
-        }
+    return client->length < MAX_REQUEST_LENGTH;
+}
 
-        if(!verifyPalettes(fileInfo.paletteIndexSegment, &header)) {
-            freeAll(&fileInfo);
-            return "Invalid palette index used!\n";
-        }
+int serveRequests(const char *socketPath, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                  enum fibVersion fibVersion, size_t cacheBytes) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
 
-        uint32_t *palette = genBasePalette(fileInfo.paletteSegment, header.paletteLength, 0);
+    if(strlen(socketPath) >= sizeof(address.sun_path)) {
+        printf("Socket path is too long!\n");
+        return -1;
+    }
 
-        imageData = convBodyDataCompressed((uint32_t *) fileInfo.bodySegment, palette, fileInfo.paletteIndexSegment, &header);
+    strcpy(address.sun_path, socketPath);
 
-        free(palette);
-    } else {
-        if(!verifyColors(fileInfo.bodySegment, &header)) {
-            freeAll(&fileInfo);
-            fclose(inputFile);
-            return "Invalid color index used!\n";
-        }
+    struct stat existing;
 
-        if(!readBlock(&parser, inputFile, fileLength)) {
-            freeAll(&fileInfo);
-            fclose(inputFile);
-            return "Malformed palette segment descriptor!\n";
+    // Only a stale socket gets replaced, so a mistyped path can't delete anything else
+    if(!lstat(socketPath, &existing)) {
+        if(!S_ISSOCK(existing.st_mode)) {
+            printf("Socket path already exists and isn't a socket!\n");
+            return -1;
         }
 
-        fclose(inputFile);
+        unlink(socketPath);
+    }
 
-        fileInfo.paletteSegment = (uint16_t *) parser.blockData;
-        parser.blockData = NULL;
+    int serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
 
-        if(parser.dataLen != header.paletteLength) {
-            freeAll(&fileInfo);
-            return "Palette's length does not match what is reported in header!\n";
-        }
-
-        uint32_t *palette = genBasePalette(fileInfo.paletteSegment, header.paletteLength, header.color0Transparent);
+    if(serverFd < 0) {
+        printf("Unable to create socket!\n");
+        return -1;
+    }
 
-        if(header.textureFormat == A3I5) {
-            palette = genA3I5Palette(palette, header.paletteLength / 2);
-        } else if(header.textureFormat == A5I3) {
-            palette = genA5I3Palette(palette, header.paletteLength / 2);
-        }
+    if(bind(serverFd, (struct sockaddr *) &address, sizeof(address)) || listen(serverFd, 16)) {
+        printf("Unable to listen on socket!\n");
+        close(serverFd);
+        return -1;
+    }
 
-        imageData = convBodyDataPalette(fileInfo.bodySegment, palette, totalRes, header.bpp);
+    lruCache cache;
+    paletteCache palettes;
 
-        free(palette);
+    if(!lruInit(&cache, cacheBytes, &freeCachedValue)) {
+        close(serverFd);
+        unlink(socketPath);
+        return -1;
     }
 
-    int pathLen = strlen(path);
+    if(!paletteCacheInit(&palettes, PALETTE_CACHE_BYTES)) {
+        lruDestroy(&cache);
+        close(serverFd);
+        unlink(socketPath);
+        return -1;
+    }
 
-    char *outputPath = malloc(pathLen + 5);
-    strcpy(outputPath, path);
-    strcat(outputPath, ".tga");
+    // No SA_RESTART, so a signal breaks out of poll
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = &handleStopSignal;
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+    signal(SIGPIPE, SIG_IGN);
 
-    FILE *outFile = fopen(outputPath, "wb");
+    clientConnection *clients = malloc(sizeof(clientConnection) * MAX_CLIENTS);
+    struct pollfd pollFds[MAX_CLIENTS + 1];
+    int numClients = 0;
 
-    free(outputPath);
+    // Connections are multiplexed with poll, so an idle client never holds up the others.
+    // Requests are still answered one at a time, in the order they're read.
+    while(!stopServing) {
+        pollFds[0].fd = serverFd;
+        pollFds[0].events = POLLIN;
 
-    if(!outFile) {
-        freeAll(&fileInfo);
-        free(imageData);
+        for(int i = 0; i < numClients; i++) {
+            pollFds[i + 1].fd = clients[i].fd;
+            pollFds[i + 1].events = POLLIN;
+        }
 
-        return "Failed to open output file!\n";
-    }
+        if(poll(pollFds, numClients + 1, -1) < 0) {
+            continue;
+        }
 
-    fputc(0, outFile);
-    fputc(0, outFile);
-    fputc(2, outFile);
+        // Backwards, so a closed client can be replaced by the last one without skipping anything
+        for(int i = numClients - 1; i >= 0; i--) {
+            if(!(pollFds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
 
-    fputc(0, outFile);
-    fputc(0, outFile);
-    fputc(0, outFile);
-    fputc(0, outFile);
-    fputc(0, outFile);
+            if(!readRequests(&clients[i], &cache, &palettes, readBlock, startOffset, fibVersion)) {
+                close(clients[i].fd);
+                clients[i] = clients[--numClients];
+            }
+        }
 
-    fputc(0, outFile);
-    fputc(0, outFile);
+        if(pollFds[0].revents & POLLIN) {
+            int clientFd = accept(serverFd, NULL, NULL);
 
-    fputc(0, outFile);
-    fputc(0, outFile);
+            if(clientFd < 0) {
+                continue;
+            }
 
-    fwrite(&header.hres, 2, 1, outFile);
-    fwrite(&header.vres, 2, 1, outFile);
-    
-    fputc(32, outFile);
-    fputc(0b00111000, outFile);
+            if(numClients == MAX_CLIENTS) {
+                sendError(clientFd, "Too many connections!\n");
+                close(clientFd);
+                continue;
+            }
 
-    fwrite(imageData, 4, totalRes, outFile);
-    free(imageData);
+            clients[numClients].fd = clientFd;
+            clients[numClients].length = 0;
+            numClients++;
+        }
+    }
 
-    fclose(outFile);
+    for(int i = 0; i < numClients; i++) {
+        close(clients[i].fd);
+    }
 
-    freeAll(&fileInfo);
+    free(clients);
+    lruDestroy(&cache);
+    paletteCacheDestroy(&palettes);
+    close(serverFd);
+    unlink(socketPath);
 
-    return NULL;
+    return 0;
 }
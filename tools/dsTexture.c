@@ -0,0 +1,714 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// This code currently makes assumptions about padding and endianness.
+// As such, it is non-portable, though will probably work on all modern desktop systems.
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsTexture.h"
+#include "paletteCache.h"
+
+// Stores allocated buffers for easier cleanup
+typedef struct _ttfTGAFile {
+    uint8_t *bodySegment;
+    uint16_t *paletteSegment;
+    uint16_t *paletteIndexSegment;
+
+    blockParser *parser;
+} ttfTGAFile;
+
+// Lookup tables to convert color spaces to 8 bit depth
+const uint8_t colorConv5[32] = {0x00, 0x08, 0x10, 0x19, 0x21, 0x29, 0x31, 0x3A,
+                                0x42, 0x4A, 0x52, 0x5A, 0x63, 0x6B, 0x73, 0x7B,
+                                0x84, 0x8C, 0x94, 0x9C, 0xA5, 0xAD, 0xB5, 0xBD,
+                                0xC5, 0xCE, 0xD6, 0xDE, 0xE6, 0xEF, 0xF7, 0xFF};
+const uint8_t colorConv3[8]  = {0x00, 0x24, 0x49, 0x6D, 0x92, 0xB6, 0xDB, 0xFF};
+const uint8_t colorConv1[2]  = {0xFF, 0xFF}; // For alpha bit
+
+// Palette entry masks applying each alpha value of A5I3 and A3I5 textures
+#define ALPHA_MASK(X) (((uint32_t) (X) << 24) | 0x00FFFFFF)
+
+static const uint32_t alphaMask5[32] = {
+    ALPHA_MASK(0x00), ALPHA_MASK(0x08), ALPHA_MASK(0x10), ALPHA_MASK(0x19),
+    ALPHA_MASK(0x21), ALPHA_MASK(0x29), ALPHA_MASK(0x31), ALPHA_MASK(0x3A),
+    ALPHA_MASK(0x42), ALPHA_MASK(0x4A), ALPHA_MASK(0x52), ALPHA_MASK(0x5A),
+    ALPHA_MASK(0x63), ALPHA_MASK(0x6B), ALPHA_MASK(0x73), ALPHA_MASK(0x7B),
+    ALPHA_MASK(0x84), ALPHA_MASK(0x8C), ALPHA_MASK(0x94), ALPHA_MASK(0x9C),
+    ALPHA_MASK(0xA5), ALPHA_MASK(0xAD), ALPHA_MASK(0xB5), ALPHA_MASK(0xBD),
+    ALPHA_MASK(0xC5), ALPHA_MASK(0xCE), ALPHA_MASK(0xD6), ALPHA_MASK(0xDE),
+    ALPHA_MASK(0xE6), ALPHA_MASK(0xEF), ALPHA_MASK(0xF7), ALPHA_MASK(0xFF)
+};
+
+// colorConv5[j * 4 + j / 2], rather than colorConv3
+static const uint32_t alphaMask3[8] = {
+    ALPHA_MASK(0x00), ALPHA_MASK(0x21), ALPHA_MASK(0x4A), ALPHA_MASK(0x6B),
+    ALPHA_MASK(0x94), ALPHA_MASK(0xB5), ALPHA_MASK(0xDE), ALPHA_MASK(0xFF)
+};
+
+// Palette indices of each pixel in a 2 bpp byte, first pixel in the low bits
+#define INDICES_2BPP(B) {(B) & 0x03, ((B) >> 2) & 0x03, ((B) >> 4) & 0x03, ((B) >> 6) & 0x03}
+#define INDICES_2BPP_4(B) INDICES_2BPP(B), INDICES_2BPP((B) + 1), INDICES_2BPP((B) + 2), INDICES_2BPP((B) + 3)
+#define INDICES_2BPP_16(B) INDICES_2BPP_4(B), INDICES_2BPP_4((B) + 4), INDICES_2BPP_4((B) + 8), INDICES_2BPP_4((B) + 12)
+#define INDICES_2BPP_64(B) INDICES_2BPP_16(B), INDICES_2BPP_16((B) + 16), INDICES_2BPP_16((B) + 32), \
+                           INDICES_2BPP_16((B) + 48)
+
+static const uint8_t indices2bpp[256][4] = {
+    INDICES_2BPP_64(0), INDICES_2BPP_64(64), INDICES_2BPP_64(128), INDICES_2BPP_64(192)
+};
+
+// Highest palette index used by any pixel in a byte, for 2 and 4 bpp
+#define MAX2(A, B) ((A) > (B) ? (A) : (B))
+#define MAX_INDEX_2BPP(B) MAX2(MAX2((B) & 0x03, ((B) >> 2) & 0x03), MAX2(((B) >> 4) & 0x03, (B) >> 6))
+#define MAX_INDEX_4BPP(B) MAX2((B) & 0x0F, (B) >> 4)
+
+#define BYTE_TABLE_4(F, B) F(B), F((B) + 1), F((B) + 2), F((B) + 3)
+#define BYTE_TABLE_16(F, B) BYTE_TABLE_4(F, B), BYTE_TABLE_4(F, (B) + 4), BYTE_TABLE_4(F, (B) + 8), \
+                            BYTE_TABLE_4(F, (B) + 12)
+#define BYTE_TABLE_64(F, B) BYTE_TABLE_16(F, B), BYTE_TABLE_16(F, (B) + 16), BYTE_TABLE_16(F, (B) + 32), \
+                            BYTE_TABLE_16(F, (B) + 48)
+#define BYTE_TABLE(F) BYTE_TABLE_64(F, 0), BYTE_TABLE_64(F, 64), BYTE_TABLE_64(F, 128), BYTE_TABLE_64(F, 192)
+
+static const uint8_t maxIndex2bpp[256] = {BYTE_TABLE(MAX_INDEX_2BPP)};
+static const uint8_t maxIndex4bpp[256] = {BYTE_TABLE(MAX_INDEX_4BPP)};
+
+// Generic paletted kernels. Every caller passes a constant format or bpp, so once inlined
+// the per-pixel loops and format checks fold away into one specialized loop per format.
+#define SPECIALIZED static inline __attribute__((always_inline))
+
+SPECIALIZED uint8_t maxIndexInByte(const uint8_t byte, const enum dsTextureFormat format) {
+    switch(format) {
+        case A3I5:
+            return byte & 0x1F;
+        case PALETTE_2_BPP:
+            return maxIndex2bpp[byte];
+        case PALETTE_4_BPP:
+            return maxIndex4bpp[byte];
+        case A5I3:
+            return byte & 0x07;
+        default:
+            return byte;
+    }
+}
+
+SPECIALIZED uint8_t verifyPaletted(const uint8_t *bodyData, const uint32_t bodyBytes, const uint32_t colors,
+                                   const enum dsTextureFormat format, const uint32_t indexCount) {
+    // Every possible index has a color
+    if(colors >= indexCount) {
+        return 1;
+    }
+
+    for(uint32_t i = 0; i < bodyBytes; i++) {
+        if(maxIndexInByte(bodyData[i], format) >= colors) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+SPECIALIZED void decodeByte(const uint8_t currByte, const uint32_t *palette, uint32_t *imageData, const uint32_t i,
+                            const uint8_t bpp) {
+    if(bpp == 2) {
+        const uint8_t *indices = indices2bpp[currByte];
+
+        imageData[i * 4] = palette[indices[0]];
+        imageData[i * 4 + 1] = palette[indices[1]];
+        imageData[i * 4 + 2] = palette[indices[2]];
+        imageData[i * 4 + 3] = palette[indices[3]];
+    } else if(bpp == 4) {
+        imageData[i * 2] = palette[currByte & 0x0F];
+        imageData[i * 2 + 1] = palette[currByte >> 4];
+    } else {
+        imageData[i] = palette[currByte];
+    }
+}
+
+SPECIALIZED void decodePaletted(const uint8_t *bodyData, const uint32_t *palette, uint32_t *imageData,
+                                const uint32_t bodyBytes, const uint8_t bpp) {
+    for(uint32_t i = 0; i < bodyBytes; i++) {
+        decodeByte(bodyData[i], palette, imageData, i, bpp);
+    }
+}
+
+// Decodes and validates in a single pass over the body. Invalid indices are only tracked, through the
+// running maximum, and decoded like any other (the palette covers every index), so the loop never branches on data.
+SPECIALIZED uint8_t decodeVerifyPaletted(const uint8_t *bodyData, const uint32_t *palette, uint32_t *imageData,
+                                         const uint32_t bodyBytes, const uint32_t colors,
+                                         const enum dsTextureFormat format, const uint8_t bpp,
+                                         const uint32_t indexCount) {
+    if(colors >= indexCount) {
+        decodePaletted(bodyData, palette, imageData, bodyBytes, bpp);
+        return 1;
+    }
+
+    uint8_t maxIndex = 0;
+
+    for(uint32_t i = 0; i < bodyBytes; i++) {
+        const uint8_t currByte = bodyData[i];
+        const uint8_t byteMax = maxIndexInByte(currByte, format);
+
+        maxIndex = byteMax > maxIndex ? byteMax : maxIndex;
+        decodeByte(currByte, palette, imageData, i, bpp);
+    }
+
+    return maxIndex < colors;
+}
+
+void freeAll(ttfTGAFile *buffers) {
+    free(buffers->bodySegment);
+    free(buffers->paletteSegment);
+    free(buffers->paletteIndexSegment);
+
+    free(buffers->parser->blockSizes);
+    free(buffers->parser->blockData);
+}
+
+bool processHeader(blockParser *source, dsBTGAHeader *header) {
+    if(source->dataLen != 0x1C) {
+        return false;
+    }
+
+    uint8_t formatByte;
+    
+    memcpy(&header->clobbered0, source->blockData, 4);
+    memcpy(&header->bodyLength, source->blockData + 0x04, 4);
+    memcpy(&header->clobbered1, source->blockData + 0x08, 4);
+    memcpy(&header->paletteLength, source->blockData + 0x0C, 4);
+    memcpy(&header->clobbered2, source->blockData + 0x10, 4);
+    memcpy(&header->paletteIndexLength, source->blockData + 0x14, 4);
+    memcpy(&formatByte, source->blockData + 0x18, 1);
+    header->textureFormat = formatByte;
+    memcpy(&header->color0Transparent, source->blockData + 0x19, 1);
+    memcpy(&header->hwidth, source->blockData + 0x1A, 1);
+    memcpy(&header->hheight, source->blockData + 0x1B, 1);
+
+    // Paletted texture missing palette
+    if(!header->paletteLength && header->textureFormat != 0x07) {
+        return false;
+    }
+
+    // Compressed texture missing segment
+    if(!header->paletteIndexLength && header->textureFormat == 0x05) {
+        return false;
+    }
+
+    switch(header->textureFormat) {
+        case NO_TEXTURE:
+            return false;
+            break;
+        case A3I5:
+            header->bpp = 8;
+            header->indexBits = 5;
+            header->alphaConvTable = colorConv3;
+            break;
+        case PALETTE_2_BPP:
+            header->bpp = 2;
+            header->indexBits = 2;
+            break;
+        case PALETTE_4_BPP:
+            header->bpp = 4;
+            header->indexBits = 4;
+            break;
+        case PALETTE_8_BPP:
+            header->bpp = 8;
+            header->indexBits = 8;
+            break;
+        case COMPRESSED:
+            if(header->paletteIndexLength != header->bodyLength / 2) {
+                return false;
+            }
+
+            header->bpp = 2;
+            break;
+        case A5I3:
+            header->bpp = 8;
+            header->indexBits = 3;
+            header->alphaConvTable = colorConv5;
+            break;
+        case DIRECT_TEXTURE:
+            header->bpp = 16;
+            break;
+        default:
+            return false;
+    }
+
+    header->hres = 8 << (header->hwidth & 0x07);
+    header->vres = 8 << (header->hheight & 0x07);
+
+    // Body length not matching resolution
+    if(header->hres * header->vres * header->bpp != header->bodyLength * 8) {
+        return NULL;
+    }
+
+    free(source->blockData);
+    source->blockData = NULL;
+
+    return header;
+}
+
+// Return 0 if an invalid palette index is used
+uint8_t verifyColors(uint8_t *bodyData, dsBTGAHeader *header) {
+    const uint32_t bodyBytes = header->bodyLength;
+    const uint32_t colors = header->paletteLength / 2;
+
+    switch(header->textureFormat) {
+        case A3I5:
+            return verifyPaletted(bodyData, bodyBytes, colors, A3I5, 32);
+        case PALETTE_2_BPP:
+            return verifyPaletted(bodyData, bodyBytes, colors, PALETTE_2_BPP, 4);
+        case PALETTE_4_BPP:
+            return verifyPaletted(bodyData, bodyBytes, colors, PALETTE_4_BPP, 16);
+        case PALETTE_8_BPP:
+            return verifyPaletted(bodyData, bodyBytes, colors, PALETTE_8_BPP, 256);
+        case A5I3:
+            return verifyPaletted(bodyData, bodyBytes, colors, A5I3, 8);
+        default:
+            return 0;
+    }
+}
+
+// Return 0 if a compressed texture's palette indexing table points to an invalid palette 
+uint8_t verifyPalettes(uint16_t *indexData, dsBTGAHeader *header) {
+    const uint32_t indexEntries = header->paletteIndexLength / 2;
+
+    for(int i = 0; i < indexEntries; i++) {
+        if((indexData[i] & 0x3FFF) * 4 > header->paletteLength) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// Convert 16-bit DS palettes to true color BGRA
+// Padded with zeroes to cover every index a paletted texture can encode, plus the 4 colors a compressed block
+// index can reach past the end, so out of range indices still read defined memory.
+static void fillBasePalette(uint32_t *palette, const uint16_t *source, uint32_t length, uint8_t color0Transparent) {
+    int paletteSize = length / 2;
+    int paddedSize = paletteSize + 4 > 256 ? paletteSize + 4 : 256;
+
+    memset(palette + paletteSize, 0, (paddedSize - paletteSize) * 4);
+
+    if(color0Transparent) {
+        palette[0] = CONVRGB555(source[0]) & 0x00FFFFFF;
+    } else {
+        palette[0] = CONVRGB555(source[0]);
+    }
+
+    for(int i = 1; i < paletteSize; i++) {
+        palette[i] = CONVRGB555(source[i]);
+    }
+}
+
+// Repeats each of the first indexColors base colors at every alpha level. The slots no color reaches are zeroed,
+// like the base palette's padding.
+static void fillAlphaPalette(uint32_t *palette, const uint32_t *baseColors, uint8_t numColors, int indexColors,
+                             const uint32_t *alphaMask) {
+    memset(palette, 0, sizeof(uint32_t) * 256);
+
+    if(numColors > indexColors) {
+        numColors = indexColors;
+    }
+
+    for(int i = 0; i < numColors; i++) {
+        const uint32_t baseColor = baseColors[i];
+        for(int j = 0; j < 256 / indexColors; j++) {
+            palette[i + j * indexColors] = baseColor & alphaMask[j];
+        }
+    }
+}
+
+uint32_t *genBasePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent) {
+    const uint32_t paddedSize = length / 2 + 4 > 256 ? length / 2 + 4 : 256;
+    uint32_t *palette = malloc(paddedSize * 4);
+
+    if(palette) {
+        fillBasePalette(palette, source, length, color0Transparent);
+    }
+
+    return palette;
+}
+
+uint32_t *genA5I3Palette(uint32_t *basePalette, uint8_t numColors) {
+    uint32_t *fullPalette = malloc(sizeof(uint32_t) * 256);
+
+    basePalette[0] |= 0xFF000000;
+    fillAlphaPalette(fullPalette, basePalette, numColors, 8, alphaMask5);
+
+    free(basePalette);
+
+    return fullPalette;
+}
+
+uint32_t *genA3I5Palette(uint32_t *basePalette, uint8_t numColors) {
+    uint32_t *fullPalette = malloc(sizeof(uint32_t) * 256);
+
+    basePalette[0] |= 0xFF000000;
+    fillAlphaPalette(fullPalette, basePalette, numColors, 32, alphaMask3);
+
+    free(basePalette);
+
+    return fullPalette;
+}
+
+void fillTexturePalette(uint32_t *palette, const uint16_t *source, uint32_t length, uint8_t color0Transparent,
+                        enum dsTextureFormat format) {
+    if(format == A3I5 || format == A5I3) {
+        // Alpha formats always make color 0 opaque, and only the colors an index can reach are converted.
+        // The color count is truncated to 8 bits, the same as passing it to genA3I5Palette / genA5I3Palette.
+        const int indexColors = format == A3I5 ? 32 : 8;
+        const uint8_t numColors = length / 2;
+        uint32_t baseColors[32];
+
+        for(int i = 0; i < numColors && i < indexColors; i++) {
+            baseColors[i] = CONVRGB555(source[i]);
+        }
+
+        fillAlphaPalette(palette, baseColors, numColors, indexColors, format == A3I5 ? alphaMask3 : alphaMask5);
+    } else {
+        fillBasePalette(palette, source, length, format == COMPRESSED ? 0 : color0Transparent);
+    }
+}
+
+uint32_t *genTexturePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent,
+                            enum dsTextureFormat format) {
+    uint32_t *palette = malloc(texturePaletteEntries(length, format) * 4);
+
+    if(palette) {
+        fillTexturePalette(palette, source, length, color0Transparent, format);
+    }
+
+    return palette;
+}
+
+uint32_t texturePaletteEntries(uint32_t length, enum dsTextureFormat format) {
+    if(format == A3I5 || format == A5I3) {
+        return 256;
+    }
+
+    return length / 2 + 4 > 256 ? length / 2 + 4 : 256;
+}
+
+uint32_t blend888(const uint32_t color0, const uint32_t color1, const int mix0, const int mix1) {
+    const int mixTotal = mix0 + mix1;
+    const uint32_t componentOne = (((color0 >> 16) & 0xFF) * mix0 + ((color1 >> 16) & 0xFF) * mix1) / mixTotal;
+    const uint32_t componentTwo = (((color0 >> 8) & 0xFF) * mix0 + ((color1 >> 8) & 0xFF) * mix1) / mixTotal;
+    const uint32_t componentThree = ((color0 & 0xFF) * mix0 + (color1 & 0xFF) * mix1) / mixTotal;
+
+    return (componentOne << 16) | (componentTwo << 8) | componentThree;
+}
+
+uint32_t *convBodyDataDC(uint16_t *bodyData, uint32_t res) {
+    uint32_t *imageData = malloc(sizeof(uint32_t) * res);
+
+    for(int i = 0; i < res; i++) {
+        imageData[i] = CONVRGBA5551(bodyData[i]);
+    }
+
+    return imageData;
+}
+
+uint32_t *convBodyDataPalette(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp) {
+    uint32_t *imageData = malloc(sizeof(uint32_t) * res);
+
+    switch(bpp) {
+        case 2:
+            decodePaletted(bodyData, palette, imageData, res / 4, 2);
+            break;
+        case 4:
+            decodePaletted(bodyData, palette, imageData, res / 2, 4);
+            break;
+        default:
+            decodePaletted(bodyData, palette, imageData, res, 8);
+            break;
+    }
+
+    return imageData;
+}
+
+// Returns 0 if any block palette index was out of range. Those are only tracked when verifying,
+// and decoded with palette 0 in their place so the loop doesn't branch on them.
+SPECIALIZED uint8_t decodeCompressed(const uint32_t *bodyData, const uint32_t *palette, const uint16_t *indexTable,
+                                     const dsBTGAHeader *header, uint32_t *imageData, const bool verify) {
+    const uint32_t blocks = header->bodyLength / 4;
+    const uint32_t width = header->hres;
+    const uint32_t hBlocks = width / 4;
+    const uint32_t maxIndex = header->paletteLength / 4;
+    uint32_t outOfRange = 0;
+
+    uint32_t blockPalette[4];
+
+    for(int i = 0; i < blocks; i++) {
+        uint32_t blockData = bodyData[i];
+        uint16_t indexData = indexTable[i];
+        uint32_t paletteIndex = indexData & 0x3FFF;
+
+        if(verify) {
+            const uint32_t indexInvalid = paletteIndex > maxIndex;
+
+            outOfRange |= indexInvalid;
+            paletteIndex = indexInvalid ? 0 : paletteIndex;
+        }
+
+        const uint32_t *paletteBase = palette + paletteIndex * 2;
+
+        blockPalette[0] = paletteBase[0];
+        blockPalette[1] = paletteBase[1];
+
+        switch(indexData >> 14) {
+            case 0:
+                blockPalette[2] = paletteBase[2];
+                blockPalette[3] = 0;
+                break;
+            case 1:
+                blockPalette[2] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 1, 1);
+                blockPalette[3] = 0;
+                break;
+            case 2:
+                blockPalette[2] = paletteBase[2];
+                blockPalette[3] = paletteBase[3];
+                break;
+            case 3:
+                blockPalette[2] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 5, 3);
+                blockPalette[3] = 0xFF000000 | blend888(blockPalette[0], blockPalette[1], 3, 5);
+                break;
+        }
+
+        for(int j = 0; j < 4; j++) {
+            for(int k = 0; k < 4; k++) {
+                imageData[((i / hBlocks) * width * 4) + ((i % hBlocks) * 4) + j * width + k] = blockPalette[blockData & 0x03];
+                blockData >>= 2;
+            }
+        }
+    }
+
+    return !outOfRange;
+}
+
+uint32_t *convBodyDataCompressed(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header) {
+    uint32_t *imageData = malloc(sizeof(uint32_t) * header->hres * header->vres);
+
+    decodeCompressed(bodyData, palette, indexTable, header, imageData, false);
+
+    return imageData;
+}
+
+uint32_t *convVerifyBodyDataPalette(uint8_t *bodyData, const uint32_t *palette, dsBTGAHeader *header) {
+    const uint32_t bodyBytes = header->bodyLength;
+    const uint32_t colors = header->paletteLength / 2;
+    uint32_t *imageData = malloc(sizeof(uint32_t) * header->hres * header->vres);
+    uint8_t valid;
+
+    switch(header->textureFormat) {
+        case A3I5:
+            valid = decodeVerifyPaletted(bodyData, palette, imageData, bodyBytes, colors, A3I5, 8, 32);
+            break;
+        case PALETTE_2_BPP:
+            valid = decodeVerifyPaletted(bodyData, palette, imageData, bodyBytes, colors, PALETTE_2_BPP, 2, 4);
+            break;
+        case PALETTE_4_BPP:
+            valid = decodeVerifyPaletted(bodyData, palette, imageData, bodyBytes, colors, PALETTE_4_BPP, 4, 16);
+            break;
+        case PALETTE_8_BPP:
+            valid = decodeVerifyPaletted(bodyData, palette, imageData, bodyBytes, colors, PALETTE_8_BPP, 8, 256);
+            break;
+        case A5I3:
+            valid = decodeVerifyPaletted(bodyData, palette, imageData, bodyBytes, colors, A5I3, 8, 8);
+            break;
+        default:
+            valid = 0;
+    }
+
+    if(!valid) {
+        free(imageData);
+        return NULL;
+    }
+
+    return imageData;
+}
+
+uint32_t *convVerifyBodyDataCompressed(uint32_t *bodyData, const uint32_t *palette, uint16_t *indexTable,
+                                       dsBTGAHeader *header) {
+    uint32_t *imageData = malloc(sizeof(uint32_t) * header->hres * header->vres);
+
+    if(!decodeCompressed(bodyData, palette, indexTable, header, imageData, true)) {
+        free(imageData);
+        return NULL;
+    }
+
+    return imageData;
+}
+
+static const uint32_t *getPalette(paletteCache *palettes, uint16_t *source, dsBTGAHeader *header) {
+    if(palettes) {
+        return acquirePalette(palettes, source, header->paletteLength, header->color0Transparent,
+                              header->textureFormat);
+    }
+
+    return genTexturePalette(source, header->paletteLength, header->color0Transparent, header->textureFormat);
+}
+
+static void putPalette(paletteCache *palettes, const uint32_t *palette) {
+    if(palettes) {
+        releasePalette(palettes, palette);
+    } else {
+        free((uint32_t *) palette);
+    }
+}
+
+char *decodeTGA(FILE *inputFile, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                paletteCache *palettes, dsBTGAHeader *header, uint32_t **imageData) {
+    fseek(inputFile, 0, SEEK_END);
+    long fileLength = ftell(inputFile);
+    fseek(inputFile, startOffset, SEEK_SET);
+
+    // Minimum header length
+    if(fileLength < 0x28) {
+        fclose(inputFile);
+        return "Requested file is too short to possibly be a TTF TGA!\n";
+    }
+
+    ttfTGAFile fileInfo;
+    memset(&fileInfo, 0, sizeof(fileInfo));
+
+    blockParser parser;
+    parser.blockSizes = NULL;
+    parser.rereadSizes = true;
+    fileInfo.parser = &parser;
+
+    if(!readBlock(&parser, inputFile, fileLength)) {
+        fclose(inputFile);
+        return "Malformed header segment descriptor!\n";
+    }
+
+    if(!processHeader(&parser, header)) {
+        freeAll(&fileInfo);
+        fclose(inputFile);
+        return "Issue relating to header!\n";
+    }
+
+    if(!readBlock(&parser, inputFile, fileLength)) {
+        freeAll(&fileInfo);
+        fclose(inputFile);
+        return "Malformed body segment descriptor!\n";
+    }
+
+    fileInfo.bodySegment = parser.blockData;
+    parser.blockData = NULL;
+
+    if(parser.dataLen != header->bodyLength) {
+        freeAll(&fileInfo);
+        fclose(inputFile);
+        return "Body's length does not match what is reported in header!\n";
+    }
+
+    uint32_t totalRes = header->hres * header->vres;
+
+    if(header->textureFormat == DIRECT_TEXTURE) {
+        fclose(inputFile);
+        *imageData = convBodyDataDC((uint16_t *) fileInfo.bodySegment, totalRes);
+    } else if(header->textureFormat == COMPRESSED) {
+        if(!readBlock(&parser, inputFile, fileLength)) {
+            freeAll(&fileInfo);
+            fclose(inputFile);
+            return "Malformed palette segment descriptor!\n";
+        }
+
+        fileInfo.paletteSegment = (uint16_t *) parser.blockData;
+        parser.blockData = NULL;
+
+        if(parser.dataLen != header->paletteLength) {
+            freeAll(&fileInfo);
+            fclose(inputFile);
+            return "Palette's length does not match what is reported in header!\n";
+        }
+
+        if(!readBlock(&parser, inputFile, fileLength)) {
+            freeAll(&fileInfo);
+            fclose(inputFile);
+            return "Malformed palette index segment descriptor!\n";
+        }
+
+        fclose(inputFile);
+
+        fileInfo.paletteIndexSegment = (uint16_t *) parser.blockData;
+        parser.blockData = NULL;
+
+        if(parser.dataLen != header->paletteIndexLength) {
+            freeAll(&fileInfo);
+            return "Palette index's length does not match what is reported in header!\n";
+        }
+
+        const uint32_t *palette = getPalette(palettes, fileInfo.paletteSegment, header);
+
+        if(!palette) {
+            freeAll(&fileInfo);
+            return "Couldn't allocate palette!\n";
+        }
+
+        *imageData = convVerifyBodyDataCompressed((uint32_t *) fileInfo.bodySegment, palette, fileInfo.paletteIndexSegment, header);
+
+        putPalette(palettes, palette);
+
+        if(!*imageData) {
+            freeAll(&fileInfo);
+            return "Invalid palette index used!\n";
+        }
+    } else {
+        // Color indices are only validated during decoding, so earlier failures must still report them first
+        if(!readBlock(&parser, inputFile, fileLength)) {
+            const uint8_t validColors = verifyColors(fileInfo.bodySegment, header);
+
+            freeAll(&fileInfo);
+            fclose(inputFile);
+            return validColors ? "Malformed palette segment descriptor!\n" : "Invalid color index used!\n";
+        }
+
+        fclose(inputFile);
+
+        fileInfo.paletteSegment = (uint16_t *) parser.blockData;
+        parser.blockData = NULL;
+
+        if(parser.dataLen != header->paletteLength) {
+            const uint8_t validColors = verifyColors(fileInfo.bodySegment, header);
+
+            freeAll(&fileInfo);
+            return validColors ? "Palette's length does not match what is reported in header!\n" :
+                                 "Invalid color index used!\n";
+        }
+
+        const uint32_t *palette = getPalette(palettes, fileInfo.paletteSegment, header);
+
+        if(!palette) {
+            freeAll(&fileInfo);
+            return "Couldn't allocate palette!\n";
+        }
+
+        *imageData = convVerifyBodyDataPalette(fileInfo.bodySegment, palette, header);
+
+        putPalette(palettes, palette);
+
+        if(!*imageData) {
+            freeAll(&fileInfo);
+            return "Invalid color index used!\n";
+        }
+    }
+
+    freeAll(&fileInfo);
+
+    return NULL;
+}
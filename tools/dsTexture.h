@@ -0,0 +1,109 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DS_TEXTURE_H
+#define DS_TEXTURE_H
+
+// Decoding of DS BTGAs to BGRA. See documentation/btgaInfoDS.md.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ttfContainer.h"
+
+enum dsTextureFormat {
+    NO_TEXTURE,
+    A3I5,
+    PALETTE_2_BPP,
+    PALETTE_4_BPP,
+    PALETTE_8_BPP,
+    COMPRESSED,
+    A5I3,
+    DIRECT_TEXTURE
+};
+
+typedef struct _dsBTGAHeader {
+    uint32_t clobbered0;
+    uint32_t bodyLength;
+    uint32_t clobbered1;
+    uint32_t paletteLength;
+    uint32_t clobbered2;
+    uint32_t paletteIndexLength;
+    enum dsTextureFormat textureFormat;
+    uint8_t color0Transparent;
+    uint8_t hwidth;
+    uint8_t hheight;
+
+    // Values generated from header values
+    uint8_t bpp;
+    uint32_t hres; // 8 << hwidth
+    uint32_t vres; // 8 << hheight
+    uint8_t indexBits;
+    const uint8_t *alphaConvTable;
+} dsBTGAHeader;
+
+// Lookup tables to convert color spaces to 8 bit depth
+extern const uint8_t colorConv5[32];
+extern const uint8_t colorConv3[8];
+extern const uint8_t colorConv1[2]; // For alpha bit
+
+#define CONVRGB555(X) (0xFF000000 | (colorConv5[(X) & 0x001F] << 16) | \
+                        (colorConv5[((X) & 0x03E0) >> 5] << 8) | \
+                        (colorConv5[((X) & 0x7C00) >> 10]))
+
+#define CONVRGBA5551(X) ((colorConv1[(X) >> 15] << 24) | (colorConv5[(X) & 0x001F] << 16) | \
+                        (colorConv5[((X) & 0x03E0) >> 5] << 8) | \
+                        (colorConv5[((X) & 0x7C00) >> 10]))
+
+// Verifies if current block is a valid BTGA header. Frees block before returning on success
+bool processHeader(blockParser *source, dsBTGAHeader *header);
+
+uint8_t verifyColors(uint8_t *bodyData, dsBTGAHeader *header);
+uint8_t verifyPalettes(uint16_t *indexData, dsBTGAHeader *header);
+
+uint32_t *genBasePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent);
+uint32_t *genA5I3Palette(uint32_t *basePalette, uint8_t numColors);
+uint32_t *genA3I5Palette(uint32_t *basePalette, uint8_t numColors);
+uint32_t blend888(const uint32_t color0, const uint32_t color1, const int mix0, const int mix1);
+
+// The complete palette a texture decodes with: genBasePalette, followed by genA3I5Palette / genA5I3Palette for
+// the alpha formats. Compressed textures ignore color0Transparent.
+uint32_t *genTexturePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent,
+                            enum dsTextureFormat format);
+// Builds the same palette into a caller owned buffer of texturePaletteEntries entries
+void fillTexturePalette(uint32_t *palette, const uint16_t *source, uint32_t length, uint8_t color0Transparent,
+                        enum dsTextureFormat format);
+// Number of entries in a palette from genTexturePalette, padding included
+uint32_t texturePaletteEntries(uint32_t length, enum dsTextureFormat format);
+
+uint32_t *convBodyDataDC(uint16_t *bodyData, uint32_t res);
+uint32_t *convBodyDataPalette(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp);
+uint32_t *convBodyDataCompressed(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header);
+
+// Single pass validate and decode, returning NULL if verifyColors / verifyPalettes would have rejected the texture.
+// The palette must come from genTexturePalette or a paletteCache.
+uint32_t *convVerifyBodyDataPalette(uint8_t *bodyData, const uint32_t *palette, dsBTGAHeader *header);
+uint32_t *convVerifyBodyDataCompressed(uint32_t *bodyData, const uint32_t *palette, uint16_t *indexTable,
+                                       dsBTGAHeader *header);
+
+typedef struct _paletteCache paletteCache; // See paletteCache.h
+
+// Takes ownership of inputFile. On success, imageData is a malloc'd BGRA buffer of hres * vres pixels.
+// Palettes are taken from palettes if it isn't NULL, and built for this texture alone otherwise.
+char *decodeTGA(FILE *inputFile, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                paletteCache *palettes, dsBTGAHeader *header, uint32_t **imageData);
+
+#endif
@@ -0,0 +1,439 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fib.h"
+
+#define FIB_HEADER_LENGTH 0x14
+#define FIB_BASE_CHUNK_SIZE 0x8000
+
+#define COMPRESSION_NONE 0
+#define COMPRESSION_REFPACK 1
+#define COMPRESSION_DEFLATE 3
+
+// Standard reflected CRC32 lookup table, built at compile time so it's shared between threads without any setup.
+// CRC32 is linear, so each entry is the XOR of the entries for its set bits.
+#define CRC_BIT(B, BIT, ENTRY) (((B) & (BIT)) ? (uint32_t) (ENTRY) : 0)
+#define CRC_ENTRY(B) (CRC_BIT(B, 0x01, 0x77073096) ^ CRC_BIT(B, 0x02, 0xEE0E612C) ^ CRC_BIT(B, 0x04, 0x076DC419) ^ \
+                      CRC_BIT(B, 0x08, 0x0EDB8832) ^ CRC_BIT(B, 0x10, 0x1DB71064) ^ CRC_BIT(B, 0x20, 0x3B6E20C8) ^ \
+                      CRC_BIT(B, 0x40, 0x76DC4190) ^ CRC_BIT(B, 0x80, 0xEDB88320))
+#define CRC_ENTRY_4(B) CRC_ENTRY(B), CRC_ENTRY((B) + 1), CRC_ENTRY((B) + 2), CRC_ENTRY((B) + 3)
+#define CRC_ENTRY_16(B) CRC_ENTRY_4(B), CRC_ENTRY_4((B) + 4), CRC_ENTRY_4((B) + 8), CRC_ENTRY_4((B) + 12)
+#define CRC_ENTRY_64(B) CRC_ENTRY_16(B), CRC_ENTRY_16((B) + 16), CRC_ENTRY_16((B) + 32), CRC_ENTRY_16((B) + 48)
+
+static const uint32_t crcTable[256] = {
+    CRC_ENTRY_64(0), CRC_ENTRY_64(64), CRC_ENTRY_64(128), CRC_ENTRY_64(192)
+};
+
+bool fibParseVersion(const char *string, enum fibVersion *version) {
+    if(!strcmp(string, "1")) {
+        *version = FIB_V1;
+    } else if(!strcmp(string, "2")) {
+        *version = FIB_V2;
+    } else if(!strcmp(string, "2.5")) {
+        *version = FIB_V2_5;
+    } else if(!strcmp(string, "3")) {
+        *version = FIB_V3;
+    } else if(!strcmp(string, "3.5")) {
+        *version = FIB_V3_5;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool fibOpen(fibArchive *archive, const char *path, enum fibVersion version) {
+    memset(archive, 0, sizeof(*archive));
+    archive->fd = -1;
+    archive->version = version;
+
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+        return false;
+    }
+
+    struct stat fileInfo;
+
+    if(fstat(fd, &fileInfo) || fileInfo.st_size < FIB_HEADER_LENGTH) {
+        close(fd);
+        return false;
+    }
+
+    const uint8_t *data = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(data == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    archive->fd = fd;
+    archive->data = data;
+    archive->length = fileInfo.st_size;
+
+    // Only the first 4 bytes of the magic are checked in-game
+    if(memcmp(data, "FUSE", 4)) {
+        fibClose(archive);
+        return false;
+    }
+
+    uint32_t filetableOffset;
+
+    memcpy(&archive->hashedEntries, data + 0x08, 4);
+    memcpy(&archive->namedEntries, data + 0x0C, 4);
+    memcpy(&filetableOffset, data + 0x10, 4);
+
+    const uint64_t totalEntries = (uint64_t) archive->hashedEntries + archive->namedEntries;
+
+    if(filetableOffset + totalEntries * sizeof(fibEntry) > archive->length) {
+        fibClose(archive);
+        return false;
+    }
+
+    archive->hashedTable = malloc(totalEntries * sizeof(fibEntry) + 1);
+    archive->namedPaths = malloc(archive->namedEntries * sizeof(char *) + 1);
+
+    if(!archive->hashedTable || !archive->namedPaths) {
+        fibClose(archive);
+        return false;
+    }
+
+    // Copied out since the filetable offset isn't guaranteed to be aligned
+    memcpy(archive->hashedTable, data + filetableOffset, totalEntries * sizeof(fibEntry));
+    archive->namedTable = archive->hashedTable + archive->hashedEntries;
+
+    uint64_t pathOffset = filetableOffset + totalEntries * sizeof(fibEntry);
+
+    for(uint32_t i = 0; i < archive->namedEntries; i++) {
+        const uint32_t pathSize = archive->namedTable[i].hash;
+
+        if(!pathSize || pathOffset + pathSize > archive->length || data[pathOffset + pathSize - 1]) {
+            fibClose(archive);
+            return false;
+        }
+
+        archive->namedPaths[i] = (const char *) data + pathOffset;
+        pathOffset += pathSize;
+    }
+
+    return true;
+}
+
+void fibClose(fibArchive *archive) {
+    if(archive->data) {
+        munmap((void *) archive->data, archive->length);
+    }
+
+    if(archive->fd >= 0) {
+        close(archive->fd);
+    }
+
+    free(archive->hashedTable);
+    free(archive->namedPaths);
+
+    memset(archive, 0, sizeof(*archive));
+    archive->fd = -1;
+}
+
+uint32_t fibHashPath(const char *path) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for(; *path; path++) {
+        const uint8_t c = tolower((unsigned char) *path);
+        crc = crcTable[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    }
+
+    // A standard CRC32 would invert here, which the fibfile hash then inverts back
+    return crc;
+}
+
+const fibEntry *fibFindHash(const fibArchive *archive, uint32_t hash) {
+    uint32_t low = 0;
+    uint32_t high = archive->hashedEntries;
+
+    while(low < high) {
+        const uint32_t mid = low + (high - low) / 2;
+        const uint32_t midHash = archive->hashedTable[mid].hash;
+
+        if(midHash == hash) {
+            return &archive->hashedTable[mid];
+        } else if(midHash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return NULL;
+}
+
+const fibEntry *fibFindPath(const fibArchive *archive, const char *path) {
+    for(uint32_t i = 0; i < archive->namedEntries; i++) {
+        if(!strcmp(archive->namedPaths[i], path)) {
+            return &archive->namedTable[i];
+        }
+    }
+
+    return fibFindHash(archive, fibHashPath(path));
+}
+
+uint32_t fibEntrySize(const fibArchive *archive, const fibEntry *entry) {
+    if(archive->version >= FIB_V3) {
+        return entry->flagSize >> 5;
+    }
+
+    return entry->flagSize & 0x3FFFFFFF;
+}
+
+uint8_t fibEntryCompression(const fibArchive *archive, const fibEntry *entry) {
+    if(archive->version >= FIB_V3) {
+        return entry->flagSize & 0x03;
+    }
+
+    return entry->flagSize >> 30;
+}
+
+uint32_t fibEntryChunkSize(const fibArchive *archive, const fibEntry *entry) {
+    if(archive->version >= FIB_V3) {
+        return FIB_BASE_CHUNK_SIZE << ((entry->flagSize >> 2) & 0x07);
+    }
+
+    return FIB_BASE_CHUNK_SIZE;
+}
+
+// Returns the number of bytes written to dest, which is only meaningful if the chunk was well formed
+static uint32_t refpackDecompress(const uint8_t *source, uint32_t sourceLength, uint8_t *dest, uint32_t destLength,
+                                  enum fibVersion version) {
+    uint32_t sourcePos = 0;
+    uint32_t destPos = 0;
+
+    while(sourcePos < sourceLength) {
+        const uint8_t b0 = source[sourcePos];
+        uint32_t literalLength;
+        uint32_t copyLength = 0;
+        uint32_t copyOffset = 0;
+        bool lastCommand = false;
+
+        if(b0 < 0x80) {
+            if(sourcePos + 2 > sourceLength) {
+                break;
+            }
+
+            const uint8_t b1 = source[sourcePos + 1];
+
+            if(version == FIB_V1) {
+                literalLength = b0 & 0x03;
+                copyLength = ((b0 >> 2) & 0x07) + 3;
+                copyOffset = ((b0 & 0x60) << 3) | b1;
+            } else {
+                literalLength = (b0 >> 2) & 0x03;
+                copyLength = ((b0 >> 4) & 0x07) + 3;
+                copyOffset = ((b0 & 0x03) << 8) | b1;
+            }
+
+            sourcePos += 2;
+        } else if(b0 < 0xC0) {
+            if(sourcePos + 3 > sourceLength) {
+                break;
+            }
+
+            const uint8_t b1 = source[sourcePos + 1];
+            const uint8_t b2 = source[sourcePos + 2];
+
+            literalLength = b1 >> 6;
+            copyLength = (b0 & 0x3F) + 4;
+            copyOffset = ((b1 & 0x3F) << 8) | b2;
+
+            sourcePos += 3;
+        } else if(b0 < 0xE0) {
+            if(sourcePos + 4 > sourceLength) {
+                break;
+            }
+
+            const uint8_t b1 = source[sourcePos + 1];
+            const uint8_t b2 = source[sourcePos + 2];
+            const uint8_t b3 = source[sourcePos + 3];
+
+            if(version == FIB_V1) {
+                literalLength = b0 & 0x03;
+                copyLength = ((((b0 >> 2) & 0x03) << 8) | b3) + 5;
+                copyOffset = ((b0 & 0x10) << 12) | (b1 << 8) | b2;
+            } else {
+                literalLength = (b0 >> 3) & 0x03;
+                copyLength = ((((b0 >> 1) & 0x03) << 8) | b3) + 5;
+                copyOffset = ((b0 & 0x01) << 16) | (b1 << 8) | b2;
+            }
+
+            sourcePos += 4;
+        } else if(b0 >= 0xFC) {
+            literalLength = b0 & 0x03;
+            lastCommand = true;
+            sourcePos++;
+        } else {
+            literalLength = ((b0 & 0x1F) << 2) + 4;
+            sourcePos++;
+        }
+
+        if(sourcePos + literalLength > sourceLength || destPos + literalLength > destLength) {
+            break;
+        }
+
+        memcpy(dest + destPos, source + sourcePos, literalLength);
+        sourcePos += literalLength;
+        destPos += literalLength;
+
+        if(copyLength) {
+            // The dictionary resets on chunk boundaries
+            if(copyOffset >= destPos || destPos + copyLength > destLength) {
+                break;
+            }
+
+            // Overlapping copies are expected, so this has to go byte by byte
+            const uint8_t *copySource = dest + destPos - copyOffset - 1;
+
+            for(uint32_t i = 0; i < copyLength; i++) {
+                dest[destPos + i] = copySource[i];
+            }
+
+            destPos += copyLength;
+        }
+
+        if(lastCommand) {
+            break;
+        }
+    }
+
+    return destPos;
+}
+
+fibChunk *fibEntryChunks(const fibArchive *archive, const fibEntry *entry, uint32_t *chunkCount) {
+    const uint32_t entrySize = fibEntrySize(archive, entry);
+    const uint32_t chunkSize = fibEntryChunkSize(archive, entry);
+    const uint32_t count = entrySize / chunkSize + (entrySize % chunkSize != 0);
+    const bool compressed = fibEntryCompression(archive, entry);
+    uint64_t filePos = entry->offset;
+
+    fibChunk *chunks = malloc(count * sizeof(fibChunk) + 1);
+
+    if(!chunks) {
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < count; i++) {
+        fibChunk *chunk = &chunks[i];
+
+        chunk->size = i == count - 1 ? entrySize - i * chunkSize : chunkSize;
+
+        if(!compressed) {
+            chunk->length = chunk->size;
+            chunk->compression = COMPRESSION_NONE;
+        } else {
+            uint32_t chunkHeader;
+
+            if(filePos + 4 > archive->length) {
+                free(chunks);
+                return NULL;
+            }
+
+            memcpy(&chunkHeader, archive->data + filePos, 4);
+            filePos += 4;
+
+            // Compression is decided per chunk before version 3, and per file from version 3 onward
+            if(archive->version >= FIB_V3) {
+                chunk->length = chunkHeader;
+                chunk->compression = fibEntryCompression(archive, entry);
+            } else {
+                chunk->length = chunkHeader & 0x3FFFFFFF;
+                chunk->compression = chunkHeader >> 30;
+            }
+        }
+
+        chunk->offset = filePos;
+
+        if(filePos + chunk->length > archive->length) {
+            free(chunks);
+            return NULL;
+        }
+
+        filePos += chunk->length;
+    }
+
+    *chunkCount = count;
+
+    return chunks;
+}
+
+bool fibReadChunk(const fibArchive *archive, const fibChunk *chunk, uint8_t *dest) {
+    const uint8_t *chunkData = archive->data + chunk->offset;
+    uint32_t produced;
+
+    if(chunk->compression == COMPRESSION_REFPACK) {
+        produced = refpackDecompress(chunkData, chunk->length, dest, chunk->size, archive->version);
+    } else if(chunk->compression == COMPRESSION_DEFLATE &&
+              (archive->version == FIB_V2_5 || archive->version == FIB_V3_5)) {
+        // Deflate never shipped on DS, which is all these tools target
+        return false;
+    } else {
+        // Invalid compression types are interpreted as literal data
+        produced = chunk->length < chunk->size ? chunk->length : chunk->size;
+        memcpy(dest, chunkData, produced);
+    }
+
+    return produced == chunk->size;
+}
+
+uint8_t *fibReadEntry(const fibArchive *archive, const fibEntry *entry, uint32_t *length) {
+    uint32_t chunkCount;
+    fibChunk *chunks = fibEntryChunks(archive, entry, &chunkCount);
+
+    if(!chunks) {
+        return NULL;
+    }
+
+    const uint32_t entrySize = fibEntrySize(archive, entry);
+    uint8_t *entryData = malloc(entrySize + 1);
+
+    if(!entryData) {
+        free(chunks);
+        return NULL;
+    }
+
+    uint32_t written = 0;
+
+    for(uint32_t i = 0; i < chunkCount; i++) {
+        if(!fibReadChunk(archive, &chunks[i], entryData + written)) {
+            free(chunks);
+            free(entryData);
+            return NULL;
+        }
+
+        written += chunks[i].size;
+    }
+
+    free(chunks);
+
+    *length = entrySize;
+
+    return entryData;
+}
@@ -0,0 +1,91 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIB_H
+#define FIB_H
+
+// Read-only access to FIB (FUSE1.00) archives. See documentation/fibInfo.md.
+// Like convTGA, this assumes a little endian host with natural struct packing.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The variant can't be detected from the file, so it has to be supplied by the user
+enum fibVersion {
+    FIB_V1,
+    FIB_V2,
+    FIB_V2_5,
+    FIB_V3,
+    FIB_V3_5
+};
+
+typedef struct _fibEntry {
+    uint32_t hash; // Path string size for named entries
+    uint32_t offset;
+    uint32_t flagSize;
+} fibEntry;
+
+// Where one chunk of an entry is stored. Uncompressed entries have no chunk headers, so they're
+// described as chunk sized slices of literal data.
+typedef struct _fibChunk {
+    uint64_t offset; // Stored data, past the chunk header
+    uint32_t length; // Stored length
+    uint32_t size;   // Decompressed length
+    uint8_t compression;
+} fibChunk;
+
+typedef struct _fibArchive {
+    enum fibVersion version;
+    int fd;
+    const uint8_t *data; // Memory mapped fibfile
+    size_t length;
+
+    uint32_t hashedEntries;
+    uint32_t namedEntries;
+    fibEntry *hashedTable; // Sorted by ascending hash
+    fibEntry *namedTable;  // Shares an allocation with hashedTable
+    const char **namedPaths;
+} fibArchive;
+
+// Accepts "1", "2", "2.5", "3", or "3.5"
+bool fibParseVersion(const char *string, enum fibVersion *version);
+
+bool fibOpen(fibArchive *archive, const char *path, enum fibVersion version);
+void fibClose(fibArchive *archive);
+
+// Bitwise not of the standard CRC32 of the lowercased path
+uint32_t fibHashPath(const char *path);
+
+const fibEntry *fibFindHash(const fibArchive *archive, uint32_t hash);
+// Searches the named filetable first, same as the games do
+const fibEntry *fibFindPath(const fibArchive *archive, const char *path);
+
+uint32_t fibEntrySize(const fibArchive *archive, const fibEntry *entry);
+// 0 for uncompressed, nonzero otherwise
+uint8_t fibEntryCompression(const fibArchive *archive, const fibEntry *entry);
+// Maximum decompressed length of a single chunk
+uint32_t fibEntryChunkSize(const fibArchive *archive, const fibEntry *entry);
+
+// Walks the entry's chunk headers without decompressing anything. Returns a malloc'd array of chunkCount chunks,
+// or NULL if the entry runs past the end of the fibfile.
+fibChunk *fibEntryChunks(const fibArchive *archive, const fibEntry *entry, uint32_t *chunkCount);
+// Decompresses a single chunk into dest, which must hold chunk->size bytes. Chunks are independent of each other.
+bool fibReadChunk(const fibArchive *archive, const fibChunk *chunk, uint8_t *dest);
+
+// Returns a malloc'd copy of the entry's decompressed data, or NULL on failure
+uint8_t *fibReadEntry(const fibArchive *archive, const fibEntry *entry, uint32_t *length);
+
+#endif
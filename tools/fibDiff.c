@@ -0,0 +1,420 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Structural diff of two fibfiles that never extracts either one in full. Both hashed filetables are sorted by
+// hash, so they're merge joined in a single pass. Entries present in both are compared chunk by chunk on their
+// stored bytes, and only chunks whose stored bytes differ get decompressed.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fib.h"
+
+enum entryResult {
+    ENTRY_IDENTICAL,
+    ENTRY_RECOMPRESSED, // Same contents, different stored bytes
+    ENTRY_CHANGED,
+    ENTRY_RESIZED,
+    ENTRY_UNREADABLE
+};
+
+// Entries only present in one of the archives, which may still have been moved to a different hash
+typedef struct _unmatchedEntry {
+    const fibEntry *entry;
+    uint32_t size;
+    uint64_t contentHash;
+    bool hashed;
+    const fibEntry *movedTo;
+} unmatchedEntry;
+
+typedef struct _unmatchedList {
+    unmatchedEntry *entries;
+    uint32_t count;
+    uint32_t capacity;
+} unmatchedList;
+
+// Decompression buffers, grown to the largest chunk seen
+typedef struct _chunkBuffers {
+    uint8_t *a;
+    uint8_t *b;
+    uint32_t capacity;
+} chunkBuffers;
+
+enum entryResult compareEntries(const fibArchive *archiveA, const fibEntry *entryA, const fibArchive *archiveB,
+                                const fibEntry *entryB, chunkBuffers *buffers);
+void appendUnmatched(unmatchedList *list, const fibArchive *archive, const fibEntry *entry);
+uint32_t findMoves(const fibArchive *archiveA, unmatchedList *removed, const fibArchive *archiveB,
+                   unmatchedList *added, chunkBuffers *buffers);
+void hashContents(const fibArchive *archive, unmatchedEntry *unmatched);
+int compareSize(const void *a, const void *b);
+int compareContents(const void *a, const void *b);
+int compareHash(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+    enum fibVersion versionA;
+    enum fibVersion versionB;
+
+    if(argc != 5 || !fibParseVersion(argv[1], &versionA) || !fibParseVersion(argv[3], &versionB)) {
+        printf("Format: ./fibDiff version_a fibfile_a version_b fibfile_b\n"
+               "Where each version is one of 1, 2, 2.5, 3, or 3.5\n");
+        return -1;
+    }
+
+    fibArchive archiveA;
+    fibArchive archiveB;
+
+    if(!fibOpen(&archiveA, argv[2], versionA)) {
+        printf("Unable to open %s as a fibfile!\n", argv[2]);
+        return -1;
+    }
+
+    if(!fibOpen(&archiveB, argv[4], versionB)) {
+        printf("Unable to open %s as a fibfile!\n", argv[4]);
+        fibClose(&archiveA);
+        return -1;
+    }
+
+    if(archiveA.namedEntries || archiveB.namedEntries) {
+        printf("Named filetable entries are not compared\n");
+    }
+
+    chunkBuffers buffers;
+    memset(&buffers, 0, sizeof(buffers));
+
+    unmatchedList removed;
+    unmatchedList added;
+    memset(&removed, 0, sizeof(removed));
+    memset(&added, 0, sizeof(added));
+
+    uint32_t counts[ENTRY_UNREADABLE + 1] = {0};
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    while(i < archiveA.hashedEntries || j < archiveB.hashedEntries) {
+        const fibEntry *entryA = i < archiveA.hashedEntries ? &archiveA.hashedTable[i] : NULL;
+        const fibEntry *entryB = j < archiveB.hashedEntries ? &archiveB.hashedTable[j] : NULL;
+
+        if(!entryB || (entryA && entryA->hash < entryB->hash)) {
+            appendUnmatched(&removed, &archiveA, entryA);
+            i++;
+            continue;
+        }
+
+        if(!entryA || entryB->hash < entryA->hash) {
+            appendUnmatched(&added, &archiveB, entryB);
+            j++;
+            continue;
+        }
+
+        const enum entryResult result = compareEntries(&archiveA, entryA, &archiveB, entryB, &buffers);
+        const uint32_t sizeA = fibEntrySize(&archiveA, entryA);
+
+        counts[result]++;
+
+        if(result == ENTRY_CHANGED) {
+            printf("~ %08X  changed     0x%X bytes\n", entryA->hash, sizeA);
+        } else if(result == ENTRY_RESIZED) {
+            printf("~ %08X  resized     0x%X -> 0x%X bytes\n", entryA->hash, sizeA, fibEntrySize(&archiveB, entryB));
+        } else if(result == ENTRY_UNREADABLE) {
+            printf("! %08X  unreadable\n", entryA->hash);
+        }
+
+        i++;
+        j++;
+    }
+
+    const uint32_t moved = findMoves(&archiveA, &removed, &archiveB, &added, &buffers);
+
+    free(buffers.a);
+    free(buffers.b);
+
+    for(uint32_t k = 0; k < removed.count; k++) {
+        const unmatchedEntry *unmatched = &removed.entries[k];
+
+        if(unmatched->movedTo) {
+            printf("> %08X  moved to    %08X, 0x%X bytes\n", unmatched->entry->hash, unmatched->movedTo->hash,
+                   unmatched->size);
+        }
+    }
+
+    for(uint32_t k = 0; k < removed.count; k++) {
+        if(!removed.entries[k].movedTo) {
+            printf("- %08X  removed     0x%X bytes\n", removed.entries[k].entry->hash, removed.entries[k].size);
+        }
+    }
+
+    for(uint32_t k = 0; k < added.count; k++) {
+        if(!added.entries[k].movedTo) {
+            printf("+ %08X  added       0x%X bytes\n", added.entries[k].entry->hash, added.entries[k].size);
+        }
+    }
+
+    printf("Identical: %u (%u only after decompressing)\n"
+           "Changed: %u (%u resized)\n"
+           "Moved: %u\n"
+           "Removed: %u\n"
+           "Added: %u\n",
+           counts[ENTRY_IDENTICAL] + counts[ENTRY_RECOMPRESSED], counts[ENTRY_RECOMPRESSED],
+           counts[ENTRY_CHANGED] + counts[ENTRY_RESIZED], counts[ENTRY_RESIZED], moved,
+           removed.count - moved, added.count - moved);
+
+    if(counts[ENTRY_UNREADABLE]) {
+        printf("Unreadable: %u\n", counts[ENTRY_UNREADABLE]);
+    }
+
+    free(removed.entries);
+    free(added.entries);
+
+    fibClose(&archiveA);
+    fibClose(&archiveB);
+
+    return 0;
+}
+
+// Matching stored bytes only imply matching contents when both sides decode them the same way
+static bool sameStoredFormat(const fibArchive *archiveA, const fibChunk *chunkA, const fibArchive *archiveB,
+                             const fibChunk *chunkB) {
+    if(chunkA->compression != chunkB->compression || chunkA->length != chunkB->length) {
+        return false;
+    }
+
+    // Refpack commands differ between version 1 and everything after it
+    return !chunkA->compression || (archiveA->version == FIB_V1) == (archiveB->version == FIB_V1);
+}
+
+static bool growBuffers(chunkBuffers *buffers, uint32_t size) {
+    if(size <= buffers->capacity) {
+        return true;
+    }
+
+    uint8_t *a = realloc(buffers->a, size);
+
+    if(!a) {
+        return false;
+    }
+
+    buffers->a = a;
+
+    uint8_t *b = realloc(buffers->b, size);
+
+    if(!b) {
+        return false;
+    }
+
+    buffers->b = b;
+    buffers->capacity = size;
+
+    return true;
+}
+
+enum entryResult compareEntries(const fibArchive *archiveA, const fibEntry *entryA, const fibArchive *archiveB,
+                                const fibEntry *entryB, chunkBuffers *buffers) {
+    const uint32_t size = fibEntrySize(archiveA, entryA);
+
+    if(size != fibEntrySize(archiveB, entryB)) {
+        return ENTRY_RESIZED;
+    }
+
+    uint32_t chunkCountA;
+    uint32_t chunkCountB;
+    fibChunk *chunksA = fibEntryChunks(archiveA, entryA, &chunkCountA);
+    fibChunk *chunksB = fibEntryChunks(archiveB, entryB, &chunkCountB);
+    enum entryResult result = ENTRY_IDENTICAL;
+
+    if(!chunksA || !chunksB) {
+        result = ENTRY_UNREADABLE;
+    } else if(chunkCountA != chunkCountB) {
+        // Different chunk sizes, so chunk boundaries don't line up and the whole entries have to be compared
+        uint32_t lengthA;
+        uint32_t lengthB;
+        uint8_t *dataA = fibReadEntry(archiveA, entryA, &lengthA);
+        uint8_t *dataB = fibReadEntry(archiveB, entryB, &lengthB);
+
+        if(!dataA || !dataB) {
+            result = ENTRY_UNREADABLE;
+        } else {
+            result = memcmp(dataA, dataB, size) ? ENTRY_CHANGED : ENTRY_RECOMPRESSED;
+        }
+
+        free(dataA);
+        free(dataB);
+    } else {
+        for(uint32_t i = 0; i < chunkCountA; i++) {
+            const fibChunk *chunkA = &chunksA[i];
+            const fibChunk *chunkB = &chunksB[i];
+
+            if(sameStoredFormat(archiveA, chunkA, archiveB, chunkB) &&
+               !memcmp(archiveA->data + chunkA->offset, archiveB->data + chunkB->offset, chunkA->length)) {
+                continue;
+            }
+
+            if(!growBuffers(buffers, chunkA->size) || !fibReadChunk(archiveA, chunkA, buffers->a) ||
+               !fibReadChunk(archiveB, chunkB, buffers->b)) {
+                result = ENTRY_UNREADABLE;
+                break;
+            }
+
+            if(memcmp(buffers->a, buffers->b, chunkA->size)) {
+                result = ENTRY_CHANGED;
+                break;
+            }
+
+            result = ENTRY_RECOMPRESSED;
+        }
+    }
+
+    free(chunksA);
+    free(chunksB);
+
+    return result;
+}
+
+void appendUnmatched(unmatchedList *list, const fibArchive *archive, const fibEntry *entry) {
+    if(list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->entries = realloc(list->entries, sizeof(unmatchedEntry) * list->capacity);
+    }
+
+    unmatchedEntry *unmatched = &list->entries[list->count++];
+    unmatched->entry = entry;
+    unmatched->size = fibEntrySize(archive, entry);
+    unmatched->contentHash = 0;
+    unmatched->hashed = false;
+    unmatched->movedTo = NULL;
+}
+
+// Pairs up removed and added entries with the same contents. Only entries whose size shows up on the other side
+// are ever decompressed, and matching content hashes are only taken as a move once the entries compare equal.
+// Both lists are left sorted by hash. Returns the number of pairs.
+uint32_t findMoves(const fibArchive *archiveA, unmatchedList *removed, const fibArchive *archiveB,
+                   unmatchedList *added, chunkBuffers *buffers) {
+    qsort(removed->entries, removed->count, sizeof(unmatchedEntry), &compareSize);
+    qsort(added->entries, added->count, sizeof(unmatchedEntry), &compareSize);
+
+    uint32_t i = 0;
+    uint32_t j = 0;
+
+    while(i < removed->count && j < added->count) {
+        const uint32_t size = removed->entries[i].size;
+
+        if(size < added->entries[j].size) {
+            i++;
+        } else if(added->entries[j].size < size) {
+            j++;
+        } else {
+            for(; i < removed->count && removed->entries[i].size == size; i++) {
+                hashContents(archiveA, &removed->entries[i]);
+            }
+
+            for(; j < added->count && added->entries[j].size == size; j++) {
+                hashContents(archiveB, &added->entries[j]);
+            }
+        }
+    }
+
+    qsort(removed->entries, removed->count, sizeof(unmatchedEntry), &compareContents);
+    qsort(added->entries, added->count, sizeof(unmatchedEntry), &compareContents);
+
+    uint32_t moved = 0;
+    i = 0;
+    j = 0;
+
+    while(i < removed->count && j < added->count) {
+        const int order = compareContents(&removed->entries[i], &added->entries[j]);
+
+        if(order < 0) {
+            i++;
+        } else if(order > 0) {
+            j++;
+        } else {
+            enum entryResult result = ENTRY_CHANGED;
+
+            if(removed->entries[i].hashed) {
+                result = compareEntries(archiveA, removed->entries[i].entry, archiveB, added->entries[j].entry,
+                                        buffers);
+            }
+
+            // A hash collision leaves both entries unpaired
+            if(result == ENTRY_IDENTICAL || result == ENTRY_RECOMPRESSED) {
+                removed->entries[i].movedTo = added->entries[j].entry;
+                added->entries[j].movedTo = removed->entries[i].entry;
+                moved++;
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    qsort(removed->entries, removed->count, sizeof(unmatchedEntry), &compareHash);
+    qsort(added->entries, added->count, sizeof(unmatchedEntry), &compareHash);
+
+    return moved;
+}
+
+// 64-bit FNV-1a of the decompressed contents. Unreadable entries are left unhashed and never match.
+void hashContents(const fibArchive *archive, unmatchedEntry *unmatched) {
+    uint32_t length;
+    uint8_t *data = fibReadEntry(archive, unmatched->entry, &length);
+
+    if(!data) {
+        return;
+    }
+
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for(uint32_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+
+    free(data);
+
+    unmatched->contentHash = hash;
+    unmatched->hashed = true;
+}
+
+int compareSize(const void *a, const void *b) {
+    const unmatchedEntry *entryA = a;
+    const unmatchedEntry *entryB = b;
+
+    return (entryA->size > entryB->size) - (entryA->size < entryB->size);
+}
+
+// Unhashed entries sort first within a size so they never line up with a hashed one
+int compareContents(const void *a, const void *b) {
+    const unmatchedEntry *entryA = a;
+    const unmatchedEntry *entryB = b;
+
+    if(entryA->size != entryB->size) {
+        return entryA->size > entryB->size ? 1 : -1;
+    }
+
+    if(entryA->hashed != entryB->hashed) {
+        return entryA->hashed ? 1 : -1;
+    }
+
+    return (entryA->contentHash > entryB->contentHash) - (entryA->contentHash < entryB->contentHash);
+}
+
+int compareHash(const void *a, const void *b) {
+    const unmatchedEntry *entryA = a;
+    const unmatchedEntry *entryB = b;
+
+    return (entryA->entry->hash > entryB->entry->hash) - (entryA->entry->hash < entryB->entry->hash);
+}
@@ -0,0 +1,152 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Resolves hashes and paths across all of a game's fibfiles at once, by mounting them together. Without any
+// queries, it lists the merged hashed filetable instead, with the fibfile each hash resolves to and every fibfile
+// it shadows there.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fib.h"
+#include "fibMount.h"
+
+typedef struct _lookupQuery {
+    bool byPath;
+    const char *path;
+    uint32_t hash;
+} lookupQuery;
+
+void listEntries(const fibMount *mount, const char **paths);
+bool resolveQuery(const fibMount *mount, const char **paths, const lookupQuery *query);
+
+int main(int argc, char *argv[]) {
+    lookupQuery *queries = malloc(argc * sizeof(lookupQuery));
+    int numQueries = 0;
+    int arg = 1;
+
+    for(; arg + 1 < argc && (!strcmp(argv[arg], "-h") || !strcmp(argv[arg], "-p")); arg += 2) {
+        lookupQuery *query = &queries[numQueries++];
+        query->byPath = argv[arg][1] == 'p';
+        query->path = argv[arg + 1];
+
+        if(!query->byPath) {
+            char *end;
+            query->hash = strtoul(argv[arg + 1], &end, 16);
+
+            if(!argv[arg + 1][0] || *end) {
+                printf("Malformed hash %s!\n", argv[arg + 1]);
+                free(queries);
+                return -1;
+            }
+        }
+    }
+
+    enum fibVersion version;
+
+    if(argc - arg < 2 || !fibParseVersion(argv[arg], &version)) {
+        printf("Format: ./fibLookup [-h hex_hash] [-p path]... version fibfile...\n"
+               "Where version is one of 1, 2, 2.5, 3, or 3.5\n"
+               "Fibfiles given earlier shadow later ones with the same hash\n");
+        free(queries);
+        return -1;
+    }
+
+    const char **paths = (const char **) argv + arg + 1;
+    fibMount mount;
+
+    if(!fibMountOpen(&mount, paths, argc - arg - 1, version)) {
+        printf("Unable to open every fibfile!\n");
+        free(queries);
+        return -1;
+    }
+
+    bool resolved = true;
+
+    if(!numQueries) {
+        listEntries(&mount, paths);
+    }
+
+    for(int i = 0; i < numQueries; i++) {
+        resolved &= resolveQuery(&mount, paths, &queries[i]);
+    }
+
+    fibMountClose(&mount);
+    free(queries);
+
+    return resolved ? 0 : 1;
+}
+
+void listEntries(const fibMount *mount, const char **paths) {
+    uint32_t hashes = 0;
+    uint32_t shadowed = 0;
+
+    // Entries sharing a hash are adjacent, and the first of them is the one that resolves
+    for(uint32_t i = 0; i < mount->entryCount; hashes++) {
+        const fibMountEntry *entry = &mount->entries[i];
+        const fibArchive *archive = &mount->archives[entry->archiveIndex];
+
+        printf("%08X  0x%X bytes in %s\n", entry->hash, fibEntrySize(archive, entry->entry),
+               paths[entry->archiveIndex]);
+
+        for(i++; i < mount->entryCount && mount->entries[i].hash == entry->hash; i++) {
+            printf("          shadows %s\n", paths[mount->entries[i].archiveIndex]);
+            shadowed++;
+        }
+    }
+
+    for(uint32_t i = 0; i < mount->archiveCount; i++) {
+        const fibArchive *archive = &mount->archives[i];
+
+        for(uint32_t j = 0; j < archive->namedEntries; j++) {
+            printf("%s  0x%X bytes in %s\n", archive->namedPaths[j], fibEntrySize(archive, &archive->namedTable[j]),
+                   paths[i]);
+        }
+    }
+
+    printf("%u hashes across %u fibfiles, %u shadowed\n", hashes, mount->archiveCount, shadowed);
+}
+
+// Returns false if nothing matched
+bool resolveQuery(const fibMount *mount, const char **paths, const lookupQuery *query) {
+    fibMountEntry result;
+    const fibMountEntry *entry = NULL;
+
+    if(query->byPath) {
+        if(fibMountFindPath(mount, query->path, &result)) {
+            entry = &result;
+        }
+    } else {
+        entry = fibMountFindHash(mount, query->hash);
+    }
+
+    if(!entry) {
+        printf("%s  not found\n", query->path);
+        return false;
+    }
+
+    const fibArchive *archive = &mount->archives[entry->archiveIndex];
+
+    if(query->byPath) {
+        printf("%s  ", query->path);
+    }
+
+    printf("%08X  0x%X bytes in %s\n", entry->hash, fibEntrySize(archive, entry->entry), paths[entry->archiveIndex]);
+
+    return true;
+}
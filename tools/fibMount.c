@@ -0,0 +1,142 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fibMount.h"
+
+bool fibMountOpen(fibMount *mount, const char **paths, uint32_t pathCount, enum fibVersion version) {
+    memset(mount, 0, sizeof(*mount));
+
+    mount->archives = malloc(pathCount * sizeof(fibArchive) + 1);
+
+    if(!mount->archives) {
+        return false;
+    }
+
+    uint64_t totalEntries = 0;
+
+    for(; mount->archiveCount < pathCount; mount->archiveCount++) {
+        if(!fibOpen(&mount->archives[mount->archiveCount], paths[mount->archiveCount], version)) {
+            fibMountClose(mount);
+            return false;
+        }
+
+        totalEntries += mount->archives[mount->archiveCount].hashedEntries;
+    }
+
+    if(totalEntries > UINT32_MAX) {
+        fibMountClose(mount);
+        return false;
+    }
+
+    mount->entries = malloc(totalEntries * sizeof(fibMountEntry) + 1);
+    uint32_t *positions = calloc(pathCount + 1, sizeof(uint32_t));
+
+    if(!mount->entries || !positions) {
+        free(positions);
+        fibMountClose(mount);
+        return false;
+    }
+
+    // Each hashed filetable is already sorted, so they're merged rather than sorted again.
+    // There are only ever a handful of archives, so the smallest head is found with a linear scan.
+    for(; mount->entryCount < totalEntries; mount->entryCount++) {
+        uint32_t next = UINT32_MAX;
+
+        for(uint32_t i = 0; i < pathCount; i++) {
+            const fibArchive *archive = &mount->archives[i];
+
+            if(positions[i] == archive->hashedEntries) {
+                continue;
+            }
+
+            // Strictly less, so the earliest archive goes first on equal hashes
+            if(next == UINT32_MAX ||
+               archive->hashedTable[positions[i]].hash < mount->archives[next].hashedTable[positions[next]].hash) {
+                next = i;
+            }
+        }
+
+        fibMountEntry *entry = &mount->entries[mount->entryCount];
+        entry->entry = &mount->archives[next].hashedTable[positions[next]++];
+        entry->hash = entry->entry->hash;
+        entry->archiveIndex = next;
+    }
+
+    free(positions);
+
+    return true;
+}
+
+void fibMountClose(fibMount *mount) {
+    for(uint32_t i = 0; i < mount->archiveCount; i++) {
+        fibClose(&mount->archives[i]);
+    }
+
+    free(mount->archives);
+    free(mount->entries);
+
+    memset(mount, 0, sizeof(*mount));
+}
+
+const fibMountEntry *fibMountFindHash(const fibMount *mount, uint32_t hash) {
+    uint32_t low = 0;
+    uint32_t high = mount->entryCount;
+
+    // Lower bound, so the earliest archive's entry is found when several share the hash
+    while(low < high) {
+        const uint32_t mid = low + (high - low) / 2;
+
+        if(mount->entries[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if(low == mount->entryCount || mount->entries[low].hash != hash) {
+        return NULL;
+    }
+
+    return &mount->entries[low];
+}
+
+bool fibMountFindPath(const fibMount *mount, const char *path, fibMountEntry *result) {
+    for(uint32_t i = 0; i < mount->archiveCount; i++) {
+        const fibArchive *archive = &mount->archives[i];
+
+        for(uint32_t j = 0; j < archive->namedEntries; j++) {
+            if(!strcmp(archive->namedPaths[j], path)) {
+                result->hash = fibHashPath(path);
+                result->archiveIndex = i;
+                result->entry = &archive->namedTable[j];
+                return true;
+            }
+        }
+    }
+
+    const fibMountEntry *entry = fibMountFindHash(mount, fibHashPath(path));
+
+    if(!entry) {
+        return false;
+    }
+
+    *result = *entry;
+
+    return true;
+}
@@ -0,0 +1,52 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIB_MOUNT_H
+#define FIB_MOUNT_H
+
+// A game's fibfiles opened together as one namespace. Their hashed filetables are merged into a single table
+// sorted by hash, so any asset resolves with one binary search instead of one per archive.
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fib.h"
+
+typedef struct _fibMountEntry {
+    uint32_t hash; // Copied out so lookups don't chase the entry pointer
+    uint32_t archiveIndex;
+    const fibEntry *entry; // Within archives[archiveIndex]
+} fibMountEntry;
+
+typedef struct _fibMount {
+    fibArchive *archives; // In the order they were given
+    uint32_t archiveCount;
+
+    // Sorted by hash, then archive. A hash in several archives keeps an entry for each.
+    fibMountEntry *entries;
+    uint32_t entryCount;
+} fibMount;
+
+// Fails if any of the fibfiles can't be opened
+bool fibMountOpen(fibMount *mount, const char **paths, uint32_t pathCount, enum fibVersion version);
+void fibMountClose(fibMount *mount);
+
+// A hash in several archives resolves to the earliest given, which shadows the rest
+const fibMountEntry *fibMountFindHash(const fibMount *mount, uint32_t hash);
+// Searches the named filetables first, in archive order, same as fibFindPath. Named entries aren't part of the
+// merged table, so the match is copied into result.
+bool fibMountFindPath(const fibMount *mount, const char *path, fibMountEntry *result);
+
+#endif
@@ -0,0 +1,157 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fibReader.h"
+
+bool fibReaderInit(fibReader *reader, const fibArchive *archive, size_t cacheBytes) {
+    memset(reader, 0, sizeof(*reader));
+
+    const uint64_t totalEntries = (uint64_t) archive->hashedEntries + archive->namedEntries;
+
+    reader->archive = archive;
+    reader->chunkIndex = calloc(totalEntries + 1, sizeof(fibChunk *));
+    reader->chunkCounts = calloc(totalEntries + 1, sizeof(uint32_t));
+
+    if(!reader->chunkIndex || !reader->chunkCounts || !lruInit(&reader->chunkCache, cacheBytes, &free)) {
+        free(reader->chunkIndex);
+        free(reader->chunkCounts);
+        memset(reader, 0, sizeof(*reader));
+        return false;
+    }
+
+    return true;
+}
+
+void fibReaderDestroy(fibReader *reader) {
+    const uint64_t totalEntries = (uint64_t) reader->archive->hashedEntries + reader->archive->namedEntries;
+
+    for(uint64_t i = 0; i < totalEntries; i++) {
+        free(reader->chunkIndex[i]);
+    }
+
+    free(reader->chunkIndex);
+    free(reader->chunkCounts);
+    lruDestroy(&reader->chunkCache);
+
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Returns the decompressed chunk, either owned by the cache or, if it can't be cached, by the caller through owned
+static const uint8_t *getChunk(fibReader *reader, uint32_t entryIndex, uint32_t chunkNumber, uint8_t **owned) {
+    const uint32_t key[2] = {entryIndex, chunkNumber};
+    uint8_t *chunkData = lruGet(&reader->chunkCache, key, sizeof(key));
+
+    *owned = NULL;
+
+    if(chunkData) {
+        return chunkData;
+    }
+
+    const fibChunk *chunk = &reader->chunkIndex[entryIndex][chunkNumber];
+    chunkData = malloc(chunk->size + 1);
+
+    if(!chunkData) {
+        return NULL;
+    }
+
+    if(!fibReadChunk(reader->archive, chunk, chunkData)) {
+        free(chunkData);
+        return NULL;
+    }
+
+    if(!lruPut(&reader->chunkCache, key, sizeof(key), chunkData, chunk->size)) {
+        *owned = chunkData;
+    }
+
+    return chunkData;
+}
+
+bool fibRead(fibReader *reader, const fibEntry *entry, uint32_t offset, uint32_t length, uint8_t *dest,
+             uint32_t *bytesRead) {
+    const fibArchive *archive = reader->archive;
+    const uint32_t entrySize = fibEntrySize(archive, entry);
+
+    *bytesRead = 0;
+
+    if(offset >= entrySize) {
+        return true;
+    }
+
+    if(length > entrySize - offset) {
+        length = entrySize - offset;
+    }
+
+    // Uncompressed entries are served straight from the mapping
+    if(!fibEntryCompression(archive, entry)) {
+        if((uint64_t) entry->offset + entrySize > archive->length) {
+            return false;
+        }
+
+        memcpy(dest, archive->data + entry->offset + offset, length);
+        *bytesRead = length;
+
+        return true;
+    }
+
+    const uint32_t entryIndex = entry - archive->hashedTable;
+
+    if(!reader->chunkIndex[entryIndex]) {
+        reader->chunkIndex[entryIndex] = fibEntryChunks(archive, entry, &reader->chunkCounts[entryIndex]);
+
+        if(!reader->chunkIndex[entryIndex]) {
+            return false;
+        }
+    }
+
+    const uint32_t chunkSize = fibEntryChunkSize(archive, entry);
+    uint32_t copied = 0;
+
+    while(copied < length) {
+        const uint32_t position = offset + copied;
+        const uint32_t chunkNumber = position / chunkSize;
+        const uint32_t chunkOffset = position % chunkSize;
+
+        if(chunkNumber >= reader->chunkCounts[entryIndex]) {
+            *bytesRead = copied;
+            return false;
+        }
+
+        const uint32_t chunkLength = reader->chunkIndex[entryIndex][chunkNumber].size;
+
+        uint8_t *owned;
+        const uint8_t *chunkData = getChunk(reader, entryIndex, chunkNumber, &owned);
+
+        if(!chunkData) {
+            *bytesRead = copied;
+            return false;
+        }
+
+        const uint32_t copyLength = chunkLength - chunkOffset < length - copied ? chunkLength - chunkOffset :
+                                                                                  length - copied;
+
+        memcpy(dest + copied, chunkData + chunkOffset, copyLength);
+        copied += copyLength;
+
+        free(owned);
+    }
+
+    *bytesRead = copied;
+
+    return true;
+}
@@ -0,0 +1,49 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIB_READER_H
+#define FIB_READER_H
+
+// Random access reads of fibfile entries. Chunks are compressed independently, so any byte range only needs
+// the chunks covering it decompressed. Not thread safe, use one reader per thread.
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fib.h"
+#include "lruCache.h"
+
+typedef struct _fibReader {
+    const fibArchive *archive;
+
+    // Per filetable entry (hashed, then named), built on the entry's first compressed read
+    fibChunk **chunkIndex;
+    uint32_t *chunkCounts;
+
+    // Decompressed chunks, keyed by entry and chunk number
+    lruCache chunkCache;
+} fibReader;
+
+// cacheBytes bounds the decompressed chunks kept around. The archive has to outlive the reader.
+bool fibReaderInit(fibReader *reader, const fibArchive *archive, size_t cacheBytes);
+void fibReaderDestroy(fibReader *reader);
+
+// Copies up to length bytes from offset within the entry's decompressed data into dest. bytesRead is only short
+// of length when the range runs past the end of the entry. Returns false if a covering chunk couldn't be read.
+bool fibRead(fibReader *reader, const fibEntry *entry, uint32_t offset, uint32_t length, uint8_t *dest,
+             uint32_t *bytesRead);
+
+#endif
@@ -0,0 +1,317 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Walks every file in a directory as a segment/block container, writing a .bidx block index next to each
+// file that parses cleanly, then reports how many files share each segment shape.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "ttfContainer.h"
+
+#define FINGERPRINT_LENGTH 256
+
+typedef struct _containerIndex {
+    containerIndexSegment *segments;
+    uint32_t segmentCount;
+    uint32_t segmentCapacity;
+
+    containerIndexBlock *blocks;
+    uint32_t blockCount;
+    uint32_t blockCapacity;
+} containerIndex;
+
+typedef struct _shapeCount {
+    char fingerprint[FINGERPRINT_LENGTH];
+    char *example;
+    int files;
+} shapeCount;
+
+char *indexFile(const char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                containerIndex *index);
+char *writeIndex(const char *outputPath, uint8_t version, containerIndex *index);
+void genFingerprint(containerIndex *index, bool bankedBlocks, char *fingerprint);
+int compareShapes(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+    long startOffset;
+    bool (*readBlock)(blockParser *, FILE *, long);
+
+    if(argc != 3 || !selectBlockReader(argv[1], &readBlock, &startOffset)) {
+        printf("Format: ./indexContainer version input_directory\n"
+               "Where version is one of 1, 2, 3, or 4\n");
+        return -1;
+    }
+
+    DIR *inputDir = opendir(argv[2]);
+
+    if(!inputDir) {
+        printf("Unable to open input directory!\n");
+        return -1;
+    }
+
+    int inputDirLen = strlen(argv[2]);
+
+    struct dirent *currentEntry;
+
+    containerIndex index;
+    memset(&index, 0, sizeof(index));
+
+    shapeCount *shapes = NULL;
+    int numShapes = 0;
+    int successCount = 0;
+
+    while(1) {
+        currentEntry = readdir(inputDir);
+
+        if(!currentEntry) {
+            break;
+        }
+
+        int entryNameLen = strlen(currentEntry->d_name);
+
+        // Don't index previous output
+        if(entryNameLen > 5 && !strcmp(currentEntry->d_name + entryNameLen - 5, ".bidx")) {
+            continue;
+        }
+
+        char *subfilePath = malloc(inputDirLen + entryNameLen + 7);
+
+        strcpy(subfilePath, argv[2]);
+        strcat(subfilePath, "/");
+        strcat(subfilePath, currentEntry->d_name);
+
+        if(indexFile(subfilePath, readBlock, startOffset, &index)) {
+            free(subfilePath);
+            continue;
+        }
+
+        char fingerprint[FINGERPRINT_LENGTH];
+        genFingerprint(&index, readBlock == &readV4Block, fingerprint);
+
+        int shape;
+        for(shape = 0; shape < numShapes; shape++) {
+            if(!strcmp(shapes[shape].fingerprint, fingerprint)) {
+                break;
+            }
+        }
+
+        if(shape == numShapes) {
+            shapes = realloc(shapes, sizeof(shapeCount) * (numShapes + 1));
+            strcpy(shapes[shape].fingerprint, fingerprint);
+            shapes[shape].example = strdup(currentEntry->d_name);
+            shapes[shape].files = 0;
+            numShapes++;
+        }
+
+        shapes[shape].files++;
+
+        strcat(subfilePath, ".bidx");
+
+        char *error = writeIndex(subfilePath, argv[1][0] - '0', &index);
+
+        if(error) {
+            printf("%s: %s", subfilePath, error);
+        } else {
+            successCount++;
+        }
+
+        free(subfilePath);
+    }
+
+    closedir(inputDir);
+
+    free(index.segments);
+    free(index.blocks);
+
+    qsort(shapes, numShapes, sizeof(shapeCount), &compareShapes);
+
+    printf("Segment shapes (blocks per segment, or bank magic per block for version 4):\n");
+
+    for(int i = 0; i < numShapes; i++) {
+        printf("%8i  %-40s (e.g. %s)\n", shapes[i].files, shapes[i].fingerprint, shapes[i].example);
+        free(shapes[i].example);
+    }
+
+    free(shapes);
+
+    printf("Successfully indexed %i files\n", successCount);
+
+    return 0;
+}
+
+// Indexes the whole file, failing unless the parser ends exactly at the end of the file
+char *indexFile(const char *path, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                containerIndex *index) {
+    FILE *inputFile = fopen(path, "rb");
+
+    if(!inputFile) {
+        return "Couldn't open input file!\n";
+    }
+
+    fseek(inputFile, 0, SEEK_END);
+    long fileLength = ftell(inputFile);
+    fseek(inputFile, startOffset, SEEK_SET);
+
+    // Offsets are stored as 32 bits
+    if(fileLength > UINT32_MAX) {
+        fclose(inputFile);
+        return "Requested file is too large to index!\n";
+    }
+
+    index->segmentCount = 0;
+    index->blockCount = 0;
+
+    blockParser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.rereadSizes = true;
+
+    while(readBlock(&parser, inputFile, fileLength)) {
+        free(parser.blockData);
+        parser.blockData = NULL;
+
+        const uint32_t blockOffset = ftell(inputFile) - parser.dataLen;
+
+        if(parser.newSegmentFlag || !index->segmentCount) {
+            if(index->segmentCount == index->segmentCapacity) {
+                index->segmentCapacity = index->segmentCapacity ? index->segmentCapacity * 2 : 8;
+                index->segments = realloc(index->segments, sizeof(containerIndexSegment) * index->segmentCapacity);
+            }
+
+            containerIndexSegment *segment = &index->segments[index->segmentCount++];
+
+            // Descriptor is 8 bytes followed by the size table
+            segment->offset = blockOffset - 8 - parser.numSizeEntries * 4;
+            segment->dataLength = 0;
+            segment->firstBlock = index->blockCount;
+            segment->blockCount = 0;
+        }
+
+        if(index->blockCount == index->blockCapacity) {
+            index->blockCapacity = index->blockCapacity ? index->blockCapacity * 2 : 16;
+            index->blocks = realloc(index->blocks, sizeof(containerIndexBlock) * index->blockCapacity);
+        }
+
+        containerIndexBlock *block = &index->blocks[index->blockCount++];
+        block->offset = blockOffset;
+        block->length = parser.dataLen;
+        block->blockBank = readBlock == &readV4Block ? parser.blockBank : 0;
+
+        containerIndexSegment *segment = &index->segments[index->segmentCount - 1];
+        segment->dataLength += parser.dataLen;
+        segment->blockCount++;
+    }
+
+    free(parser.blockSizes);
+
+    const long endPos = ftell(inputFile);
+
+    fclose(inputFile);
+
+    if(!index->blockCount) {
+        return "Not a container file!\n";
+    }
+
+    if(endPos != fileLength) {
+        return "Container ends before end of file!\n";
+    }
+
+    return NULL;
+}
+
+char *writeIndex(const char *outputPath, uint8_t version, containerIndex *index) {
+    FILE *outFile = fopen(outputPath, "wb");
+
+    if(!outFile) {
+        return "Failed to open output file!\n";
+    }
+
+    containerIndexHeader header;
+    memset(&header, 0, sizeof(header));
+
+    memcpy(header.magic, CONTAINER_INDEX_MAGIC, 4);
+    header.version = version;
+    header.segmentCount = index->segmentCount;
+    header.blockCount = index->blockCount;
+
+    bool written = fwrite(&header, sizeof(header), 1, outFile) == 1;
+    written &= fwrite(index->segments, sizeof(containerIndexSegment), index->segmentCount, outFile) ==
+               index->segmentCount;
+    written &= fwrite(index->blocks, sizeof(containerIndexBlock), index->blockCount, outFile) == index->blockCount;
+
+    // Buffered data only reaches the disk on fclose, so it can still fail there
+    written &= !fclose(outFile);
+
+    // A truncated index would otherwise look whole to later tools seeking through it
+    if(!written) {
+        remove(outputPath);
+        return "Failed to write output file!\n";
+    }
+
+    return NULL;
+}
+
+// Block counts per segment, e.g. "1.1.1" for a paletted BTGA. Banked blocks append their bank magic.
+// Fingerprints that don't fit are truncated with a trailing "+".
+void genFingerprint(containerIndex *index, bool bankedBlocks, char *fingerprint) {
+    int length = 0;
+    fingerprint[0] = '\0';
+
+    for(uint32_t i = 0; i < index->segmentCount; i++) {
+        const containerIndexSegment *segment = &index->segments[i];
+        char part[32];
+
+        if(bankedBlocks) {
+            for(uint32_t j = 0; j < segment->blockCount; j++) {
+                snprintf(part, sizeof(part), "%s%i", j ? "," : (i ? "." : ""),
+                         index->blocks[segment->firstBlock + j].blockBank);
+
+                if(length + strlen(part) + 2 > FINGERPRINT_LENGTH) {
+                    strcpy(fingerprint + length, "+");
+                    return;
+                }
+
+                strcpy(fingerprint + length, part);
+                length += strlen(part);
+            }
+        } else {
+            snprintf(part, sizeof(part), "%s%u", i ? "." : "", segment->blockCount);
+
+            if(length + strlen(part) + 2 > FINGERPRINT_LENGTH) {
+                strcpy(fingerprint + length, "+");
+                return;
+            }
+
+            strcpy(fingerprint + length, part);
+            length += strlen(part);
+        }
+    }
+}
+
+// Most common shapes first
+int compareShapes(const void *a, const void *b) {
+    const shapeCount *shapeA = a;
+    const shapeCount *shapeB = b;
+
+    if(shapeA->files != shapeB->files) {
+        return shapeB->files - shapeA->files;
+    }
+
+    return strcmp(shapeA->fingerprint, shapeB->fingerprint);
+}
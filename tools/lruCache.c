@@ -0,0 +1,222 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lruCache.h"
+
+#define LRU_INITIAL_BUCKETS 64
+
+// FNV-1a
+static uint32_t hashKey(const void *key, size_t keyLength) {
+    const uint8_t *bytes = key;
+    uint32_t hash = 0x811C9DC5;
+
+    for(size_t i = 0; i < keyLength; i++) {
+        hash ^= bytes[i];
+        hash *= 0x01000193;
+    }
+
+    return hash;
+}
+
+static lruEntry **findSlot(lruCache *cache, const void *key, size_t keyLength, uint32_t keyHash) {
+    lruEntry **slot = &cache->buckets[keyHash & (cache->bucketCount - 1)];
+
+    while(*slot) {
+        lruEntry *entry = *slot;
+
+        if(entry->keyHash == keyHash && entry->keyLength == keyLength && !memcmp(entry->key, key, keyLength)) {
+            break;
+        }
+
+        slot = &entry->chainNext;
+    }
+
+    return slot;
+}
+
+static void unlinkRecency(lruCache *cache, lruEntry *entry) {
+    if(entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+
+    if(entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+}
+
+static void pushFront(lruCache *cache, lruEntry *entry) {
+    entry->prev = NULL;
+    entry->next = cache->head;
+
+    if(cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+
+    cache->head = entry;
+}
+
+static void removeEntry(lruCache *cache, lruEntry **slot) {
+    lruEntry *entry = *slot;
+
+    *slot = entry->chainNext;
+    unlinkRecency(cache, entry);
+
+    cache->totalCost -= entry->cost;
+    cache->entryCount--;
+
+    if(cache->freeValue) {
+        cache->freeValue(entry->value);
+    }
+
+    free(entry);
+}
+
+static void growBuckets(lruCache *cache) {
+    uint32_t newCount = cache->bucketCount * 2;
+    lruEntry **newBuckets = calloc(newCount, sizeof(lruEntry *));
+
+    // Chains just get longer if the allocation fails
+    if(!newBuckets) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < cache->bucketCount; i++) {
+        lruEntry *entry = cache->buckets[i];
+
+        while(entry) {
+            lruEntry *next = entry->chainNext;
+            lruEntry **slot = &newBuckets[entry->keyHash & (newCount - 1)];
+
+            entry->chainNext = *slot;
+            *slot = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = newBuckets;
+    cache->bucketCount = newCount;
+}
+
+bool lruInit(lruCache *cache, size_t maxCost, void (*freeValue)(void *value)) {
+    memset(cache, 0, sizeof(*cache));
+
+    cache->buckets = calloc(LRU_INITIAL_BUCKETS, sizeof(lruEntry *));
+
+    if(!cache->buckets) {
+        return false;
+    }
+
+    cache->bucketCount = LRU_INITIAL_BUCKETS;
+    cache->maxCost = maxCost;
+    cache->freeValue = freeValue;
+
+    return true;
+}
+
+void lruDestroy(lruCache *cache) {
+    lruEntry *entry = cache->head;
+
+    while(entry) {
+        lruEntry *next = entry->next;
+
+        if(cache->freeValue) {
+            cache->freeValue(entry->value);
+        }
+
+        free(entry);
+        entry = next;
+    }
+
+    free(cache->buckets);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void *lruGet(lruCache *cache, const void *key, size_t keyLength) {
+    lruEntry *entry = *findSlot(cache, key, keyLength, hashKey(key, keyLength));
+
+    if(!entry) {
+        return NULL;
+    }
+
+    if(entry != cache->head) {
+        unlinkRecency(cache, entry);
+        pushFront(cache, entry);
+    }
+
+    return entry->value;
+}
+
+bool lruPut(lruCache *cache, const void *key, size_t keyLength, void *value, size_t cost) {
+    if(cost > cache->maxCost) {
+        return false;
+    }
+
+    const uint32_t keyHash = hashKey(key, keyLength);
+    lruEntry **slot = findSlot(cache, key, keyLength, keyHash);
+
+    if(*slot) {
+        removeEntry(cache, slot);
+    }
+
+    while(cache->totalCost + cost > cache->maxCost) {
+        lruEntry *victim = cache->tail;
+        removeEntry(cache, findSlot(cache, victim->key, victim->keyLength, victim->keyHash));
+    }
+
+    lruEntry *entry = malloc(sizeof(lruEntry) + keyLength);
+
+    if(!entry) {
+        return false;
+    }
+
+    entry->keyHash = keyHash;
+    entry->keyLength = keyLength;
+    entry->value = value;
+    entry->cost = cost;
+    memcpy(entry->key, key, keyLength);
+
+    if(cache->entryCount >= cache->bucketCount) {
+        growBuckets(cache);
+    }
+
+    slot = &cache->buckets[keyHash & (cache->bucketCount - 1)];
+    entry->chainNext = *slot;
+    *slot = entry;
+    pushFront(cache, entry);
+
+    cache->totalCost += cost;
+    cache->entryCount++;
+
+    return true;
+}
+
+void lruRemove(lruCache *cache, const void *key, size_t keyLength) {
+    lruEntry **slot = findSlot(cache, key, keyLength, hashKey(key, keyLength));
+
+    if(*slot) {
+        removeEntry(cache, slot);
+    }
+}
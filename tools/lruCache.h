@@ -0,0 +1,59 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Cost-bounded least recently used cache, keyed by arbitrary byte strings.
+// Values are owned by the cache once inserted and released through freeValue on eviction.
+typedef struct _lruEntry {
+    struct _lruEntry *prev; // Towards most recently used
+    struct _lruEntry *next; // Towards least recently used
+    struct _lruEntry *chainNext;
+    uint32_t keyHash;
+    size_t keyLength;
+    void *value;
+    size_t cost;
+    uint8_t key[];
+} lruEntry;
+
+typedef struct _lruCache {
+    lruEntry **buckets;
+    uint32_t bucketCount;
+    uint32_t entryCount;
+    lruEntry *head;
+    lruEntry *tail;
+    size_t totalCost;
+    size_t maxCost;
+    void (*freeValue)(void *value);
+} lruCache;
+
+bool lruInit(lruCache *cache, size_t maxCost, void (*freeValue)(void *value));
+void lruDestroy(lruCache *cache);
+
+// Returns NULL on a miss. A hit becomes the most recently used entry.
+// The returned value stays valid until the next lruPut or lruRemove on the same cache.
+void *lruGet(lruCache *cache, const void *key, size_t keyLength);
+
+// Returns false if the value could not be cached, in which case the caller keeps ownership of it
+bool lruPut(lruCache *cache, const void *key, size_t keyLength, void *value, size_t cost);
+void lruRemove(lruCache *cache, const void *key, size_t keyLength);
+
+#endif
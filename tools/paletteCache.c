@@ -0,0 +1,136 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "paletteCache.h"
+
+// Keys up to a full 256 color palette are built on the stack
+#define KEY_BUFFER_LENGTH (2 + 256 * 2)
+
+// The cache holds a reference while an entry is cached, and each acquirePalette holds one until released
+typedef struct _sharedPalette {
+    uint32_t references;
+    uint32_t colors[];
+} sharedPalette;
+
+#define SHARED_PALETTE(X) ((sharedPalette *) ((uint8_t *) (X) - offsetof(sharedPalette, colors)))
+
+// Only ever called with the lock held, by the cache itself or releasePalette
+static void dropReference(void *value) {
+    sharedPalette *palette = value;
+
+    if(!--palette->references) {
+        free(palette);
+    }
+}
+
+bool paletteCacheInit(paletteCache *cache, size_t maxBytes) {
+    if(!lruInit(&cache->palettes, maxBytes, &dropReference)) {
+        return false;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return true;
+}
+
+void paletteCacheDestroy(paletteCache *cache) {
+    lruDestroy(&cache->palettes);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+// Returns a referenced palette for the key, or NULL on a miss
+static sharedPalette *findPalette(paletteCache *cache, const uint8_t *key, size_t keyLength) {
+    pthread_mutex_lock(&cache->lock);
+
+    sharedPalette *palette = lruGet(&cache->palettes, key, keyLength);
+
+    if(palette) {
+        palette->references++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return palette;
+}
+
+// Caches a newly built palette and returns it referenced, unless another thread cached one for the key first
+static sharedPalette *insertPalette(paletteCache *cache, const uint8_t *key, size_t keyLength, sharedPalette *palette,
+                                    size_t cost) {
+    pthread_mutex_lock(&cache->lock);
+
+    sharedPalette *existing = lruGet(&cache->palettes, key, keyLength);
+
+    if(existing) {
+        existing->references++;
+        free(palette);
+        palette = existing;
+    } else {
+        palette->references = 2;
+
+        if(!lruPut(&cache->palettes, key, keyLength, palette, cost)) {
+            palette->references = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return palette;
+}
+
+const uint32_t *acquirePalette(paletteCache *cache, const uint16_t *source, uint32_t length,
+                               uint8_t color0Transparent, enum dsTextureFormat format) {
+    // Key is the format and transparency flag followed by the raw palette
+    uint8_t keyBuffer[KEY_BUFFER_LENGTH];
+    const size_t keyLength = length + 2;
+    uint8_t *key = keyLength <= sizeof(keyBuffer) ? keyBuffer : malloc(keyLength);
+
+    if(!key) {
+        return NULL;
+    }
+
+    key[0] = format;
+    key[1] = format != COMPRESSED && color0Transparent;
+    memcpy(key + 2, source, length);
+
+    sharedPalette *palette = findPalette(cache, key, keyLength);
+
+    if(!palette) {
+        // Built outside the lock so other threads aren't held up, at the cost of the odd duplicate build
+        const uint32_t entries = texturePaletteEntries(length, format);
+
+        palette = malloc(sizeof(sharedPalette) + entries * 4);
+
+        if(palette) {
+            fillTexturePalette(palette->colors, source, length, key[1], format);
+            palette = insertPalette(cache, key, keyLength, palette, sizeof(sharedPalette) + entries * 4 + keyLength);
+        }
+    }
+
+    if(key != keyBuffer) {
+        free(key);
+    }
+
+    return palette ? palette->colors : NULL;
+}
+
+void releasePalette(paletteCache *cache, const uint32_t *palette) {
+    pthread_mutex_lock(&cache->lock);
+    dropReference(SHARED_PALETTE(palette));
+    pthread_mutex_unlock(&cache->lock);
+}
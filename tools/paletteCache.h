@@ -0,0 +1,45 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PALETTE_CACHE_H
+#define PALETTE_CACHE_H
+
+// Thread safe cache of built texture palettes, shared by every texture with the same raw palette bytes,
+// color 0 transparency, and format. Saves rebuilding (and allocating) the palette for each texture.
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dsTexture.h"
+#include "lruCache.h"
+
+struct _paletteCache {
+    pthread_mutex_t lock;
+    lruCache palettes;
+};
+
+bool paletteCacheInit(paletteCache *cache, size_t maxBytes);
+// Every acquired palette has to be released first, since releasing one takes the cache's lock
+void paletteCacheDestroy(paletteCache *cache);
+
+// Returns the palette genTexturePalette would build. It's shared, so it must not be modified, and stays valid
+// until released even if the cache evicts it in the meantime. Returns NULL if it couldn't be allocated.
+const uint32_t *acquirePalette(paletteCache *cache, const uint16_t *source, uint32_t length,
+                               uint8_t color0Transparent, enum dsTextureFormat format);
+void releasePalette(paletteCache *cache, const uint32_t *palette);
+
+#endif
@@ -0,0 +1,49 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REFERENCE_DECODE_H
+#define REFERENCE_DECODE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "dsTexture.h"
+#include "ttfContainer.h"
+
+bool refReadV1Block(blockParser *parser, FILE *inFile, long fileLength);
+bool refReadV3Block(blockParser *parser, FILE *inFile, long fileLength);
+bool refReadV4Block(blockParser *parser, FILE *inFile, long fileLength);
+
+bool refProcessHeader(blockParser *source, dsBTGAHeader *header);
+
+uint8_t refVerifyColors(uint8_t *bodyData, dsBTGAHeader *header);
+uint8_t refVerifyPalettes(uint16_t *indexData, dsBTGAHeader *header);
+
+uint32_t *refGenBasePalette(uint16_t *source, uint32_t length, uint8_t color0Transparent);
+uint32_t *refGenA5I3Palette(uint32_t *basePalette, uint8_t numColors);
+uint32_t *refGenA3I5Palette(uint32_t *basePalette, uint8_t numColors);
+uint32_t refBlend888(const uint32_t color0, const uint32_t color1, const int mix0, const int mix1);
+
+uint32_t *refConvBodyDataDC(uint16_t *bodyData, uint32_t res);
+uint32_t *refConvBodyDataPalette(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp);
+uint32_t *refConvBodyDataCompressed(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header);
+
+// Same contract as decodeTGA
+char *refDecodeTGA(FILE *inputFile, bool (*readBlock)(blockParser *, FILE *, long), long startOffset,
+                   dsBTGAHeader *header, uint32_t **imageData);
+
+#endif
@@ -0,0 +1,264 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttfContainer.h"
+
+bool readV1Block(blockParser *parser, FILE *inFile, long fileLength) {
+    if(parser->rereadSizes) {
+        long currentPos = ftell(inFile);
+
+        if(currentPos + 0x08 > fileLength) {
+            return false;
+        }
+
+        uint16_t numBlocks;
+
+        size_t readLen = fread(&numBlocks, 0x02, 0x01, inFile);
+
+        if(readLen != 0x01 || !numBlocks) {
+            return false;
+        }
+
+        parser->numSizeEntries = numBlocks;
+        fseek(inFile, 2, SEEK_CUR);
+
+        readLen = fread(&parser->segmentLength, 0x04, 0x01, inFile);
+
+        if(readLen != 0x01 || !parser->segmentLength ||
+            currentPos + 0x08 + parser->numSizeEntries * 4 + parser->segmentLength > fileLength) {
+            return false;
+        }
+
+        parser->blockSizes = malloc(parser->numSizeEntries * 4);
+
+        fread(parser->blockSizes, 4, parser->numSizeEntries, inFile);
+
+        uint32_t totalLen = 0;
+        for(int i = 0; i < parser->numSizeEntries; i++) {
+            totalLen += parser->blockSizes[i];
+        }
+
+        if(totalLen != parser->segmentLength) {
+            free(parser->blockSizes);
+            parser->blockSizes = NULL;
+            parser->blockData = NULL;
+            return false;
+        }
+
+        parser->sizeIndex = 0;
+        parser->newSegmentFlag = true;
+        parser->rereadSizes = false;
+    } else {
+        parser->newSegmentFlag = false;
+    }
+
+    parser->dataLen = parser->blockSizes[parser->sizeIndex];
+    parser->blockData = malloc(parser->dataLen);
+    
+    if(!fread(parser->blockData, parser->dataLen, 1, inFile)) {
+        free(parser->blockData);
+        free(parser->blockSizes);
+        parser->blockData = NULL;
+        parser->blockSizes = NULL;
+        return false;
+    }
+
+    parser->sizeIndex++;
+    if(parser->sizeIndex == parser->numSizeEntries) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        parser->rereadSizes = true;
+    }
+
+    return true;
+}
+
+bool readV3Block(blockParser *parser, FILE *inFile, long fileLength) {
+    unsigned long filePos = ftell(inFile);
+    int redirections = 0;
+
+    parser->newSegmentFlag = parser->rereadSizes;
+
+    while(parser->rereadSizes) {
+        if(redirections > 5 || filePos + 8 > fileLength) {
+            return false;
+        }
+
+        uint32_t headerInfo[2];
+        if(!fread(&headerInfo, 8, 1, inFile)) {
+            return false;
+        }
+        filePos += 8;
+
+        if(headerInfo[0] & 0xFF) {
+            fseek(inFile, headerInfo[1], SEEK_CUR);
+            filePos += headerInfo[1];
+            redirections++;
+            continue;
+        }
+
+        parser->numSizeEntries = headerInfo[0] >> 16;
+        parser->segmentLength = headerInfo[1];
+
+        if(filePos + parser->numSizeEntries * 4 + parser->segmentLength > fileLength) {
+            return false;
+        }
+
+        parser->blockSizes = malloc(parser->numSizeEntries * 4);
+        fread(parser->blockSizes, 4, parser->numSizeEntries, inFile);
+
+        uint32_t totalLen = 0;
+        for(int i = 0; i < parser->numSizeEntries; i++) {
+            totalLen += parser->blockSizes[i];
+        }
+
+        if(totalLen != parser->segmentLength) {
+            free(parser->blockSizes);
+            parser->blockSizes = NULL;
+            parser->blockData = NULL;
+            return false;
+        }
+
+        parser->sizeIndex = 0;
+        parser->rereadSizes = false;
+    }
+
+    parser->dataLen = parser->blockSizes[parser->sizeIndex];
+    parser->blockData = malloc(parser->dataLen);
+    
+    if(!fread(parser->blockData, parser->dataLen, 1, inFile)) {
+        free(parser->blockData);
+        free(parser->blockSizes);
+        parser->blockData = NULL;
+        parser->blockSizes = NULL;
+        return false;
+    }
+
+    parser->sizeIndex++;
+    if(parser->sizeIndex == parser->numSizeEntries) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        parser->rereadSizes = true;
+    }
+
+    return true;
+}
+
+bool readV4Block(blockParser *parser, FILE *inFile, long fileLength) {
+    unsigned long filePos = ftell(inFile);
+    int redirections = 0;
+
+    parser->newSegmentFlag = parser->rereadSizes;
+
+    while(parser->rereadSizes) {
+        if(redirections > 5 || filePos + 8 > fileLength) {
+            return false;
+        }
+
+        uint32_t headerInfo[2];
+        if(!fread(&headerInfo, 8, 1, inFile)) {
+            return false;
+        }
+        filePos += 8;
+
+        if(headerInfo[0] & 0xFF) {
+            fseek(inFile, headerInfo[1], SEEK_CUR);
+            filePos += headerInfo[1];
+            redirections++;
+            continue;
+        }
+
+        parser->numSizeEntries = headerInfo[0] >> 8;
+        uint32_t blockSizesLength = headerInfo[1];
+
+        if(parser->numSizeEntries * 4 != blockSizesLength || filePos + parser->numSizeEntries * 4 > fileLength) {
+            return false;
+        }
+
+        parser->blockSizes = malloc(blockSizesLength);
+        fread(parser->blockSizes, blockSizesLength, 1, inFile);
+        filePos += blockSizesLength;
+        parser->sizeIndex = 0;
+        parser->rereadSizes = false;
+    }
+
+    if(parser->sizeIndex >= parser->numSizeEntries) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        return false;
+    }
+
+    int32_t blockMagic = parser->blockSizes[parser->sizeIndex];
+    parser->sizeIndex++;
+    if(blockMagic < -0x10 || blockMagic > -0x0E) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        return false;
+    }
+
+    parser->blockBank = blockMagic;
+    parser->sizesInBlock = 0;
+    parser->dataLen = 0;
+
+    while(parser->sizeIndex < parser->numSizeEntries) {
+        int32_t blockSize = parser->blockSizes[parser->sizeIndex];
+        if(blockSize >= -0x10 && blockSize <= -0x0E) {
+            break;
+        }
+        parser->sizesInBlock++;
+        parser->dataLen += blockSize;
+        parser->sizeIndex++;
+    }
+
+    if(filePos + parser->dataLen > fileLength) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        return false;
+    }
+
+    parser->blockData = malloc(parser->dataLen);
+    fread(parser->blockData, parser->dataLen, 1, inFile);
+
+    if(parser->sizeIndex == parser->numSizeEntries) {
+        free(parser->blockSizes);
+        parser->blockSizes = NULL;
+        parser->rereadSizes = true;
+    }
+
+    return true;
+}
+
+bool selectBlockReader(const char *version, bool (**readBlock)(blockParser *, FILE *, long), long *startOffset) {
+    *startOffset = 0;
+
+    if(!strcmp(version, "1")) {
+        *readBlock = &readV1Block;
+        *startOffset = 0x0C;
+    } else if(!strcmp(version, "2")) {
+        *readBlock = &readV1Block;
+    } else if(!strcmp(version, "3")) {
+        *readBlock = &readV3Block;
+    } else if(!strcmp(version, "4")) {
+        *readBlock = &readV4Block;
+    } else {
+        return false;
+    }
+
+    return true;
+}
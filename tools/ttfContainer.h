@@ -0,0 +1,74 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TTF_CONTAINER_H
+#define TTF_CONTAINER_H
+
+// Parsers for the segment/block container format. See documentation/ttFusionBinaryContainerInfo.md.
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+
+typedef struct _blockParser {
+    bool rereadSizes;
+    // Structural info
+    uint32_t numSizeEntries;
+    int32_t *blockSizes;
+    uint32_t sizeIndex;
+    // Exposed return info
+    uint32_t dataLen;
+    uint8_t *blockData;
+    // Version-specific return info
+    bool newSegmentFlag; // Set to true when block is the first of its segment
+    uint32_t segmentLength; // Versions 1-3, set to total length of segment
+    
+    uint32_t sizesInBlock; // Version 4, set to the number of size entries making up the block, minus the magic number
+    int32_t blockBank; // Version 4, set to block's magic number (requires additional research)
+} blockParser;
+
+bool readV1Block(blockParser *parser, FILE *inFile, long fileLength);
+bool readV3Block(blockParser *parser, FILE *inFile, long fileLength);
+bool readV4Block(blockParser *parser, FILE *inFile, long fileLength);
+
+// Maps a container version argument ("1" through "4") to its parser and the offset of the first segment
+bool selectBlockReader(const char *version, bool (**readBlock)(blockParser *, FILE *, long), long *startOffset);
+
+// Block index files (.bidx), as written by indexContainer. All fields little endian.
+// The header is followed by segmentCount segment records, then blockCount block records.
+#define CONTAINER_INDEX_MAGIC "TTFI"
+
+typedef struct _containerIndexHeader {
+    char magic[4];
+    uint8_t version; // Container version, 1-4
+    uint8_t padding[3];
+    uint32_t segmentCount;
+    uint32_t blockCount;
+} containerIndexHeader;
+
+typedef struct _containerIndexSegment {
+    uint32_t offset; // File offset of the segment descriptor
+    uint32_t dataLength;
+    uint32_t firstBlock;
+    uint32_t blockCount;
+} containerIndexSegment;
+
+typedef struct _containerIndexBlock {
+    uint32_t offset; // File offset of the block data
+    uint32_t length;
+    int32_t blockBank; // Version 4 only, 0 otherwise
+} containerIndexBlock;
+
+#endif
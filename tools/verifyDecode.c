@@ -0,0 +1,1672 @@
+/* Copyright (C) 2024 toadster172 <toadster172@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Differential verification of the decode path against the frozen reference in referenceDecode.c.
+// Kernels are checked in isolation on randomized inputs, container parsers are run in lockstep on randomized
+// containers, and whole files (randomized, plus any given directories) are decoded through every input path
+// across several threads. Any output that isn't byte for byte identical to the reference is reported.
+// Ranged fibfile reads are checked the same way, against whole entries from fibReadEntry, and so are lookups in
+// mounted fibfiles, against looking the hash up in each fibfile in turn. Given a convTGA binary, its daemon mode
+// is checked on fibfiles with named filetable entries, which must never be served for a hash or the other way round.
+// New implementations get checked by adding them to the variant tables below.
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "dsTexture.h"
+#include "fib.h"
+#include "fibMount.h"
+#include "fibReader.h"
+#include "paletteCache.h"
+#include "referenceDecode.h"
+#include "ttfContainer.h"
+
+#define MAX_RANDOM_HWIDTH 5 // Up to 256 pixels a side
+#define MAX_PARSER_CALLS 64
+#define MAX_THREADS 8
+// Small enough that palettes get evicted while other threads still hold them
+#define SHARED_PALETTE_BYTES (64 << 10)
+#define MAX_FIB_ENTRIES 16
+#define MAX_FIB_READER_ENTRIES 4
+#define MAX_FIB_ENTRY_CHUNKS 3
+#define FIB_READS 64
+#define MAX_MOUNTED_FIBFILES 4
+#define DAEMON_ROUNDS 8
+
+typedef struct _paletteKernel {
+    const char *name;
+    uint32_t *(*run)(uint8_t *bodyData, uint32_t *palette, uint32_t res, uint8_t bpp);
+} paletteKernel;
+
+typedef struct _compressedKernel {
+    const char *name;
+    uint32_t *(*run)(uint32_t *bodyData, uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header);
+} compressedKernel;
+
+// Validates while decoding, returning NULL for textures the reference verification rejects
+typedef struct _fusedPaletteKernel {
+    const char *name;
+    uint32_t *(*run)(uint8_t *bodyData, const uint32_t *palette, dsBTGAHeader *header);
+} fusedPaletteKernel;
+
+typedef struct _fusedCompressedKernel {
+    const char *name;
+    uint32_t *(*run)(uint32_t *bodyData, const uint32_t *palette, uint16_t *indexTable, dsBTGAHeader *header);
+} fusedCompressedKernel;
+
+typedef struct _alphaPaletteBuilder {
+    const char *name;
+    enum dsTextureFormat format;
+    uint32_t *(*run)(uint32_t *basePalette, uint8_t numColors);
+} alphaPaletteBuilder;
+
+// Where complete texture palettes come from, both in isolation and within decodeTGA
+typedef struct _paletteSource {
+    const char *name;
+    paletteCache *cache; // NULL builds each palette with genTexturePalette
+} paletteSource;
+
+typedef struct _colorVerifier {
+    const char *name;
+    uint8_t (*run)(uint8_t *bodyData, dsBTGAHeader *header);
+} colorVerifier;
+
+typedef struct _blockReader {
+    const char *name;
+    int version;
+    bool (*reference)(blockParser *, FILE *, long);
+    bool (*run)(blockParser *, FILE *, long);
+} blockReader;
+
+// Input paths a whole file can take into decodeTGA
+enum inputPath {
+    INPUT_STDIO,  // fopen, or a tmpfile for generated data
+    INPUT_MEMORY, // fmemopen over mmapped or generated data, as used for fibfile entries
+    NUM_INPUT_PATHS
+};
+
+static const char *inputPathNames[NUM_INPUT_PATHS] = {"stdio", "memory"};
+
+static const paletteKernel paletteKernels[] = {
+    {"convBodyDataPalette", &convBodyDataPalette},
+};
+
+static const compressedKernel compressedKernels[] = {
+    {"convBodyDataCompressed", &convBodyDataCompressed},
+};
+
+static const fusedPaletteKernel fusedPaletteKernels[] = {
+    {"convVerifyBodyDataPalette", &convVerifyBodyDataPalette},
+};
+
+static const fusedCompressedKernel fusedCompressedKernels[] = {
+    {"convVerifyBodyDataCompressed", &convVerifyBodyDataCompressed},
+};
+
+static const alphaPaletteBuilder alphaPaletteBuilders[] = {
+    {"genA3I5Palette", A3I5, &genA3I5Palette},
+    {"genA5I3Palette", A5I3, &genA5I3Palette},
+};
+
+static paletteCache sharedPalettes;
+
+static const paletteSource paletteSources[] = {
+    {"genTexturePalette", NULL},
+    {"paletteCache", &sharedPalettes},
+};
+
+static const colorVerifier colorVerifiers[] = {
+    {"verifyColors", &verifyColors},
+};
+
+static const blockReader blockReaders[] = {
+    {"readV1Block", 2, &refReadV1Block, &readV1Block},
+    {"readV3Block", 3, &refReadV3Block, &readV3Block},
+    {"readV4Block", 4, &refReadV4Block, &readV4Block},
+};
+
+#define NUM_VARIANTS(X) (sizeof(X) / sizeof((X)[0]))
+
+typedef struct _corpusFile {
+    char *path; // NULL for generated files
+    int version;
+    uint64_t seed;
+} corpusFile;
+
+typedef struct _corpus {
+    corpusFile *files;
+    int numFiles;
+    int nextFile;
+    pthread_mutex_t lock;
+} corpus;
+
+static pthread_mutex_t reportLock = PTHREAD_MUTEX_INITIALIZER;
+static int checksRun = 0;
+static int mismatches = 0;
+
+// xorshift64*, so every failure can be reproduced from its seed
+static uint32_t nextRandom(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return (*state * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static uint32_t randomBelow(uint64_t *state, uint32_t limit) {
+    return nextRandom(state) % limit;
+}
+
+static void fillRandom(uint64_t *state, uint8_t *buffer, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        buffer[i] = nextRandom(state);
+    }
+}
+
+static void reportResult(bool matched) {
+    pthread_mutex_lock(&reportLock);
+    checksRun++;
+    mismatches += !matched;
+    pthread_mutex_unlock(&reportLock);
+}
+
+static void reportMismatch(const char *check, const char *variant, const char *input, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    pthread_mutex_lock(&reportLock);
+    printf("MISMATCH %s [%s] on %s: ", check, variant, input);
+    vprintf(format, args);
+    printf("\n");
+    pthread_mutex_unlock(&reportLock);
+
+    va_end(args);
+}
+
+// Reports the first differing pixel, if any
+static bool comparePixels(const char *check, const char *variant, const char *input,
+                          const uint32_t *expected, const uint32_t *actual, uint32_t hres, uint32_t numPixels) {
+    for(uint32_t i = 0; i < numPixels; i++) {
+        if(expected[i] != actual[i]) {
+            reportMismatch(check, variant, input, "first differing pixel (%u, %u): expected %08X, got %08X",
+                           i % hres, i / hres, expected[i], actual[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fused kernels have to reject exactly the textures the reference rejects, and match it otherwise
+static bool compareFused(const char *check, const char *variant, const char *input,
+                         const uint32_t *expected, const uint32_t *actual, uint32_t hres, uint32_t numPixels) {
+    if(!expected != !actual) {
+        reportMismatch(check, variant, input, expected ? "rejected a valid texture" : "accepted an invalid texture");
+        return false;
+    }
+
+    return !expected || comparePixels(check, variant, input, expected, actual, hres, numPixels);
+}
+
+// Copies a palette into the zero padded layout genBasePalette produces
+static uint32_t *padPalette(const uint32_t *palette, uint32_t entries) {
+    const uint32_t paddedEntries = entries + 4 > 256 ? entries + 4 : 256;
+    uint32_t *padded = calloc(paddedEntries, 4);
+
+    memcpy(padded, palette, entries * 4);
+
+    return padded;
+}
+
+static const uint32_t *getPalette(const paletteSource *source, uint8_t *palette, uint32_t paletteLength,
+                                  uint8_t color0Transparent, enum dsTextureFormat format) {
+    if(source->cache) {
+        return acquirePalette(source->cache, (uint16_t *) palette, paletteLength, color0Transparent, format);
+    }
+
+    return genTexturePalette((uint16_t *) palette, paletteLength, color0Transparent, format);
+}
+
+static void putPalette(const paletteSource *source, const uint32_t *palette) {
+    if(source->cache) {
+        releasePalette(source->cache, palette);
+    } else {
+        free((uint32_t *) palette);
+    }
+}
+
+static const uint8_t formatBpp[8] = {0, 8, 2, 4, 8, 2, 8, 16};
+static const uint8_t formatIndexBits[8] = {0, 5, 2, 4, 8, 0, 3, 0};
+
+// Generated texture, before being wrapped in a container
+typedef struct _randomTexture {
+    uint8_t headerBlock[0x1C];
+    uint8_t *body;
+    uint32_t bodyLength;
+    uint8_t *palette;
+    uint32_t paletteLength;
+    uint8_t *paletteIndex;
+    uint32_t paletteIndexLength;
+} randomTexture;
+
+// Mostly valid textures, with a quarter using indices past the end of the palette
+static void genRandomTexture(uint64_t *state, enum dsTextureFormat format, randomTexture *texture) {
+    const uint8_t hwidth = randomBelow(state, MAX_RANDOM_HWIDTH + 1);
+    const uint8_t hheight = randomBelow(state, MAX_RANDOM_HWIDTH + 1);
+    const uint32_t res = (8 << hwidth) * (8 << hheight);
+    const uint8_t bpp = formatBpp[format];
+    const bool validIndices = randomBelow(state, 4);
+
+    memset(texture, 0, sizeof(*texture));
+
+    texture->bodyLength = res * bpp / 8;
+    texture->body = malloc(texture->bodyLength);
+    fillRandom(state, texture->body, texture->bodyLength);
+
+    if(format == COMPRESSED) {
+        // At least 4 colors, so every block palette fits, and sometimes past 256 so palette cache keys outgrow
+        // their stack buffer
+        uint32_t colors = 4 + randomBelow(state, 509);
+        texture->paletteLength = colors * 2;
+        texture->paletteIndexLength = texture->bodyLength / 2;
+        texture->paletteIndex = malloc(texture->paletteIndexLength);
+
+        // Index * 4 == paletteLength passes verifyPalettes but reads past the palette, so it's never generated
+        for(uint32_t i = 0; i < texture->paletteIndexLength / 2; i++) {
+            uint16_t entry = randomBelow(state, (colors - 4) / 2 + 1) | (randomBelow(state, 4) << 14);
+            memcpy(texture->paletteIndex + i * 2, &entry, 2);
+        }
+
+        if(!validIndices) {
+            uint16_t entry = texture->paletteLength / 4 + 1 + randomBelow(state, 0x100);
+            memcpy(texture->paletteIndex + randomBelow(state, texture->paletteIndexLength / 2) * 2, &entry, 2);
+        }
+    } else if(format != DIRECT_TEXTURE) {
+        const uint8_t indexBits = formatIndexBits[format];
+        const uint32_t colors = 1 + randomBelow(state, 1 << indexBits);
+        texture->paletteLength = colors * 2;
+
+        if(validIndices) {
+            const uint8_t ppB = 8 / bpp;
+
+            for(uint32_t i = 0; i < texture->bodyLength; i++) {
+                uint8_t byte = 0;
+
+                for(int j = 0; j < ppB; j++) {
+                    uint32_t pixel = randomBelow(state, colors) | (randomBelow(state, 256) << indexBits);
+                    byte |= (pixel & ((1 << bpp) - 1)) << (j * bpp);
+                }
+
+                texture->body[i] = byte;
+            }
+        }
+    }
+
+    if(texture->paletteLength) {
+        texture->palette = malloc(texture->paletteLength);
+        fillRandom(state, texture->palette, texture->paletteLength);
+    }
+
+    uint32_t clobbered = nextRandom(state);
+    memset(texture->headerBlock, 0, sizeof(texture->headerBlock));
+    memcpy(texture->headerBlock, &clobbered, 4);
+    memcpy(texture->headerBlock + 0x04, &texture->bodyLength, 4);
+    memcpy(texture->headerBlock + 0x08, &clobbered, 4);
+    memcpy(texture->headerBlock + 0x0C, &texture->paletteLength, 4);
+    memcpy(texture->headerBlock + 0x10, &clobbered, 4);
+    memcpy(texture->headerBlock + 0x14, &texture->paletteIndexLength, 4);
+    texture->headerBlock[0x18] = format;
+    texture->headerBlock[0x19] = randomBelow(state, 2);
+    texture->headerBlock[0x1A] = hwidth;
+    texture->headerBlock[0x1B] = hheight;
+}
+
+static void freeRandomTexture(randomTexture *texture) {
+    free(texture->body);
+    free(texture->palette);
+    free(texture->paletteIndex);
+}
+
+// Growable byte buffer for building containers
+typedef struct _byteBuffer {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} byteBuffer;
+
+// Compares every palette source against the reference palettes, on the entries a texture can read. Padding has to
+// be zero. The same palette bytes are built for every format and transparency flag, so cached palettes can't be
+// mixed up between them, and each cached palette is acquired twice to check both the miss and the following hit.
+static void checkTexturePalettes(randomTexture *texture, const char *input) {
+    static const enum dsTextureFormat paletteFormats[] = {A3I5, PALETTE_2_BPP, PALETTE_4_BPP, PALETTE_8_BPP,
+                                                          COMPRESSED, A5I3};
+    const uint32_t colors = texture->paletteLength / 2;
+    const uint8_t numColors = colors;
+
+    for(size_t i = 0; i < NUM_VARIANTS(paletteFormats) * 2; i++) {
+        const enum dsTextureFormat format = paletteFormats[i / 2];
+        const uint8_t color0Transparent = i % 2;
+        const bool alpha = format == A3I5 || format == A5I3;
+        const uint32_t entries = texturePaletteEntries(texture->paletteLength, format);
+        const uint32_t paletteColors = 1 << formatIndexBits[format];
+        const uint32_t usedColors = numColors < paletteColors ? numColors : paletteColors;
+
+        uint32_t *expected = refGenBasePalette((uint16_t *) texture->palette, texture->paletteLength,
+                                               format == COMPRESSED ? 0 : color0Transparent);
+
+        if(format == A3I5) {
+            expected = refGenA3I5Palette(expected, numColors);
+        } else if(format == A5I3) {
+            expected = refGenA5I3Palette(expected, numColors);
+        }
+
+        for(size_t j = 0; j < NUM_VARIANTS(paletteSources); j++) {
+            for(int pass = 0; pass < (paletteSources[j].cache ? 2 : 1); pass++) {
+                const uint32_t *actual = getPalette(&paletteSources[j], texture->palette, texture->paletteLength,
+                                                    color0Transparent, format);
+                bool matched = true;
+
+                for(uint32_t k = 0; k < entries && matched; k++) {
+                    const uint32_t expectedColor = alpha || k < colors ? expected[k] : 0;
+
+                    if((!alpha || k % paletteColors < usedColors) && expectedColor != actual[k]) {
+                        reportMismatch("texture palette", paletteSources[j].name, input,
+                                       "format %i, transparency %u, first differing entry %u: expected %08X, got %08X",
+                                       format, color0Transparent, k, expectedColor, actual[k]);
+                        matched = false;
+                    }
+                }
+
+                reportResult(matched);
+                putPalette(&paletteSources[j], actual);
+            }
+        }
+
+        free(expected);
+    }
+}
+
+static void appendBytes(byteBuffer *buffer, const void *data, size_t length) {
+    if(buffer->length + length > buffer->capacity) {
+        buffer->capacity = (buffer->length + length) * 2;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+static void appendWord(byteBuffer *buffer, uint32_t word) {
+    appendBytes(buffer, &word, 4);
+}
+
+// Wraps blocks in a container, grouped into segments of segmentBlocks[i] blocks.
+// Version 4 gives each segment its own size table, with banks drawn from -0x10 to -0x0E.
+// blockEnds, if given, receives the file offset just past each block.
+static void buildContainer(uint64_t *state, int version, uint8_t **blocks, uint32_t *blockLengths,
+                           const int *segmentBlocks, int numSegments, byteBuffer *out, uint32_t *blockEnds) {
+    if(version == 1) {
+        uint8_t unknownHeader[0x0C];
+        fillRandom(state, unknownHeader, sizeof(unknownHeader));
+        appendBytes(out, unknownHeader, sizeof(unknownHeader));
+    }
+
+    int block = 0;
+
+    if(version == 4) {
+        for(int i = 0; i < numSegments; i++) {
+            appendWord(out, (segmentBlocks[i] * 2) << 8);
+            appendWord(out, segmentBlocks[i] * 2 * 4);
+
+            for(int j = 0; j < segmentBlocks[i]; j++) {
+                appendWord(out, -0x10 + (int) randomBelow(state, 3));
+                appendWord(out, blockLengths[block + j]);
+            }
+
+            for(int j = 0; j < segmentBlocks[i]; j++) {
+                appendBytes(out, blocks[block + j], blockLengths[block + j]);
+
+                if(blockEnds) {
+                    blockEnds[block + j] = out->length;
+                }
+            }
+
+            block += segmentBlocks[i];
+        }
+
+        return;
+    }
+
+    for(int i = 0; i < numSegments; i++) {
+        uint32_t segmentLength = 0;
+        for(int j = 0; j < segmentBlocks[i]; j++) {
+            segmentLength += blockLengths[block + j];
+        }
+
+        // Version 3 segments may be preceded by segments the parser skips over
+        if(version == 3 && !randomBelow(state, 8)) {
+            uint32_t skipLength = randomBelow(state, 16);
+            uint8_t skipped[16];
+            fillRandom(state, skipped, skipLength);
+
+            appendWord(out, 1 + randomBelow(state, 0xFF));
+            appendWord(out, skipLength);
+            appendBytes(out, skipped, skipLength);
+        }
+
+        if(version == 3) {
+            appendWord(out, segmentBlocks[i] << 16);
+        } else {
+            appendWord(out, segmentBlocks[i]);
+        }
+
+        appendWord(out, segmentLength);
+
+        for(int j = 0; j < segmentBlocks[i]; j++) {
+            appendWord(out, blockLengths[block + j]);
+        }
+
+        for(int j = 0; j < segmentBlocks[i]; j++) {
+            appendBytes(out, blocks[block + j], blockLengths[block + j]);
+
+            if(blockEnds) {
+                blockEnds[block + j] = out->length;
+            }
+        }
+
+        block += segmentBlocks[i];
+    }
+}
+
+// Builds a whole BTGA file. A sixteenth are truncated to exercise the error paths.
+static void genRandomBTGA(uint64_t *state, int version, byteBuffer *out) {
+    randomTexture texture;
+    genRandomTexture(state, 1 + randomBelow(state, 7), &texture);
+
+    uint8_t *blocks[4] = {texture.headerBlock, texture.body, texture.palette, texture.paletteIndex};
+    uint32_t blockLengths[4] = {0x1C, texture.bodyLength, texture.paletteLength, texture.paletteIndexLength};
+    int segmentBlocks[4] = {1, 1, 1, 1};
+    int numSegments = 2 + (texture.paletteLength != 0) + (texture.paletteIndexLength != 0);
+
+    // The reference parser never leaves the first version 4 segment, so version 4 files keep every block in it
+    if(version == 4) {
+        segmentBlocks[0] = numSegments;
+        numSegments = 1;
+    }
+
+    out->length = 0;
+    buildContainer(state, version, blocks, blockLengths, segmentBlocks, numSegments, out, NULL);
+
+    if(!randomBelow(state, 16)) {
+        out->length -= randomBelow(state, out->length);
+    }
+
+    freeRandomTexture(&texture);
+}
+
+static void checkKernels(uint64_t *state, int iteration) {
+    char input[48];
+    snprintf(input, sizeof(input), "random texture %i", iteration);
+
+    const enum dsTextureFormat format = 1 + randomBelow(state, 7);
+
+    randomTexture texture;
+    genRandomTexture(state, format, &texture);
+
+    blockParser headerSource;
+    memset(&headerSource, 0, sizeof(headerSource));
+    headerSource.dataLen = 0x1C;
+    headerSource.blockData = malloc(0x1C);
+    memcpy(headerSource.blockData, texture.headerBlock, 0x1C);
+
+    dsBTGAHeader header;
+    memset(&header, 0, sizeof(header));
+
+    if(!refProcessHeader(&headerSource, &header)) {
+        free(headerSource.blockData);
+        freeRandomTexture(&texture);
+        return;
+    }
+
+    const uint32_t res = header.hres * header.vres;
+
+    if(format == DIRECT_TEXTURE) {
+        uint32_t *expected = refConvBodyDataDC((uint16_t *) texture.body, res);
+        uint32_t *actual = convBodyDataDC((uint16_t *) texture.body, res);
+
+        reportResult(comparePixels("direct color", "convBodyDataDC", input, expected, actual, header.hres, res));
+
+        free(expected);
+        free(actual);
+        freeRandomTexture(&texture);
+        return;
+    }
+
+    checkTexturePalettes(&texture, input);
+
+    uint32_t *refBase = refGenBasePalette((uint16_t *) texture.palette, texture.paletteLength,
+                                          format == COMPRESSED ? 0 : header.color0Transparent);
+    uint32_t *liveBase = genBasePalette((uint16_t *) texture.palette, texture.paletteLength,
+                                        format == COMPRESSED ? 0 : header.color0Transparent);
+
+    reportResult(comparePixels("base palette", "genBasePalette", input, refBase, liveBase, texture.paletteLength / 2,
+                               texture.paletteLength / 2));
+    free(liveBase);
+
+    if(format == COMPRESSED) {
+        const uint8_t valid = refVerifyPalettes((uint16_t *) texture.paletteIndex, &header);
+        const uint8_t liveValid = verifyPalettes((uint16_t *) texture.paletteIndex, &header);
+
+        if(valid != liveValid) {
+            reportMismatch("palette index verification", "verifyPalettes", input, "expected %u, got %u",
+                           valid, liveValid);
+        }
+
+        reportResult(valid == liveValid);
+
+        uint32_t *expected = NULL;
+
+        if(valid) {
+            expected = refConvBodyDataCompressed((uint32_t *) texture.body, refBase,
+                                                 (uint16_t *) texture.paletteIndex, &header);
+
+            for(size_t i = 0; i < NUM_VARIANTS(compressedKernels); i++) {
+                uint32_t *actual = compressedKernels[i].run((uint32_t *) texture.body, refBase,
+                                                            (uint16_t *) texture.paletteIndex, &header);
+
+                reportResult(comparePixels("compressed decode", compressedKernels[i].name, input, expected, actual,
+                                           header.hres, res));
+                free(actual);
+            }
+        }
+
+        uint32_t *paddedPalette = padPalette(refBase, texture.paletteLength / 2);
+
+        for(size_t i = 0; i < NUM_VARIANTS(fusedCompressedKernels); i++) {
+            uint32_t *actual = fusedCompressedKernels[i].run((uint32_t *) texture.body, paddedPalette,
+                                                             (uint16_t *) texture.paletteIndex, &header);
+
+            reportResult(compareFused("fused compressed decode", fusedCompressedKernels[i].name, input, expected,
+                                      actual, header.hres, res));
+            free(actual);
+        }
+
+        free(paddedPalette);
+        free(expected);
+        free(refBase);
+        freeRandomTexture(&texture);
+        return;
+    }
+
+    const uint8_t valid = refVerifyColors(texture.body, &header);
+
+    for(size_t i = 0; i < NUM_VARIANTS(colorVerifiers); i++) {
+        const uint8_t liveValid = colorVerifiers[i].run(texture.body, &header);
+
+        if(valid != liveValid) {
+            reportMismatch("color verification", colorVerifiers[i].name, input, "expected %u, got %u",
+                           valid, liveValid);
+        }
+
+        reportResult(valid == liveValid);
+    }
+
+    uint32_t *palette = refBase;
+
+    if(format == A3I5 || format == A5I3) {
+        const uint8_t numColors = texture.paletteLength / 2;
+        const uint32_t paletteColors = 1 << header.indexBits;
+        // Only entries for colors that exist get written
+        const uint32_t usedColors = numColors < paletteColors ? numColors : paletteColors;
+
+        for(size_t i = 0; i < NUM_VARIANTS(alphaPaletteBuilders); i++) {
+            if(alphaPaletteBuilders[i].format != format) {
+                continue;
+            }
+
+            uint32_t *refCopy = malloc(texture.paletteLength / 2 * 4);
+            uint32_t *liveCopy = malloc(texture.paletteLength / 2 * 4);
+            memcpy(refCopy, refBase, texture.paletteLength / 2 * 4);
+            memcpy(liveCopy, refBase, texture.paletteLength / 2 * 4);
+
+            uint32_t *expected = format == A3I5 ? refGenA3I5Palette(refCopy, numColors) :
+                                                  refGenA5I3Palette(refCopy, numColors);
+            uint32_t *actual = alphaPaletteBuilders[i].run(liveCopy, numColors);
+            bool matched = true;
+
+            for(uint32_t j = 0; j < 256 && matched; j++) {
+                if(j % paletteColors < usedColors && expected[j] != actual[j]) {
+                    reportMismatch("alpha palette", alphaPaletteBuilders[i].name, input,
+                                   "first differing entry %u: expected %08X, got %08X", j, expected[j], actual[j]);
+                    matched = false;
+                }
+            }
+
+            reportResult(matched);
+            free(expected);
+            free(actual);
+        }
+
+        uint32_t *refCopy = malloc(texture.paletteLength / 2 * 4);
+        memcpy(refCopy, refBase, texture.paletteLength / 2 * 4);
+        palette = format == A3I5 ? refGenA3I5Palette(refCopy, numColors) : refGenA5I3Palette(refCopy, numColors);
+        free(refBase);
+    }
+
+    uint32_t *expected = NULL;
+
+    if(valid) {
+        expected = refConvBodyDataPalette(texture.body, palette, res, header.bpp);
+
+        for(size_t i = 0; i < NUM_VARIANTS(paletteKernels); i++) {
+            uint32_t *actual = paletteKernels[i].run(texture.body, palette, res, header.bpp);
+
+            reportResult(comparePixels("paletted decode", paletteKernels[i].name, input, expected, actual,
+                                       header.hres, res));
+            free(actual);
+        }
+    }
+
+    uint32_t *paddedPalette = padPalette(palette, format == A3I5 || format == A5I3 ? 256 : texture.paletteLength / 2);
+
+    for(size_t i = 0; i < NUM_VARIANTS(fusedPaletteKernels); i++) {
+        uint32_t *actual = fusedPaletteKernels[i].run(texture.body, paddedPalette, &header);
+
+        reportResult(compareFused("fused paletted decode", fusedPaletteKernels[i].name, input, expected, actual,
+                                  header.hres, res));
+        free(actual);
+    }
+
+    free(paddedPalette);
+    free(expected);
+    free(palette);
+    freeRandomTexture(&texture);
+}
+
+// Runs the reference and live parser over the same randomized container, comparing every block returned.
+// The reference can't leave the first version 4 segment, so multi-segment version 4 containers are instead
+// checked against the generated blocks: each one has to be returned until the first that was cut off.
+static void checkBlockReader(uint64_t *state, const blockReader *reader, int iteration) {
+    char input[48];
+    snprintf(input, sizeof(input), "random container %i", iteration);
+
+    uint8_t *blocks[32];
+    uint32_t blockLengths[32];
+    uint32_t blockEnds[32];
+    bool segmentStarts[32];
+    int segmentBlocks[8];
+    const int numSegments = 1 + randomBelow(state, 8);
+    int numBlocks = 0;
+
+    for(int i = 0; i < numSegments; i++) {
+        segmentBlocks[i] = 1 + randomBelow(state, 4);
+
+        for(int j = 0; j < segmentBlocks[i]; j++) {
+            blockLengths[numBlocks] = 1 + randomBelow(state, 64);
+            blocks[numBlocks] = malloc(blockLengths[numBlocks]);
+            fillRandom(state, blocks[numBlocks], blockLengths[numBlocks]);
+            segmentStarts[numBlocks] = !j;
+            numBlocks++;
+        }
+    }
+
+    byteBuffer container;
+    memset(&container, 0, sizeof(container));
+    buildContainer(state, reader->version, blocks, blockLengths, segmentBlocks, numSegments, &container, blockEnds);
+
+    // Corrupt descriptors by flipping a byte somewhere, or cut the file short.
+    // Version 4 doesn't check its block reads, so it only gets truncated.
+    const uint32_t corruption = randomBelow(state, 4);
+
+    if(corruption == 1 && reader->version != 4) {
+        container.data[randomBelow(state, container.length)] ^= 1 << randomBelow(state, 8);
+    } else if(corruption == 2) {
+        container.length -= randomBelow(state, container.length);
+    }
+
+    const bool againstBlocks = reader->version == 4 && numSegments > 1;
+
+    FILE *refFile = fmemopen(container.data, container.length, "rb");
+    FILE *liveFile = fmemopen(container.data, container.length, "rb");
+
+    blockParser refParser;
+    blockParser liveParser;
+    memset(&refParser, 0, sizeof(refParser));
+    memset(&liveParser, 0, sizeof(liveParser));
+    refParser.rereadSizes = true;
+    liveParser.rereadSizes = true;
+
+    bool matched = true;
+
+    for(int call = 0; call < MAX_PARSER_CALLS && matched; call++) {
+        bool refRead;
+
+        if(againstBlocks) {
+            refRead = call < numBlocks && blockEnds[call] <= container.length;
+
+            if(refRead) {
+                refParser.dataLen = blockLengths[call];
+                refParser.blockData = malloc(blockLengths[call]);
+                memcpy(refParser.blockData, blocks[call], blockLengths[call]);
+                refParser.newSegmentFlag = segmentStarts[call];
+            }
+        } else {
+            refRead = reader->reference(&refParser, refFile, container.length);
+        }
+
+        const bool liveRead = reader->run(&liveParser, liveFile, container.length);
+
+        if(refRead != liveRead) {
+            reportMismatch("block parser", reader->name, input, "call %i: expected %s, got %s", call,
+                           refRead ? "a block" : "failure", liveRead ? "a block" : "failure");
+            matched = false;
+        } else if(refRead && (refParser.dataLen != liveParser.dataLen ||
+                              memcmp(refParser.blockData, liveParser.blockData, refParser.dataLen))) {
+            reportMismatch("block parser", reader->name, input, "call %i: block contents differ", call);
+            matched = false;
+        } else if(refRead && reader->version != 4 && (refParser.newSegmentFlag != liveParser.newSegmentFlag ||
+                                                      refParser.segmentLength != liveParser.segmentLength)) {
+            reportMismatch("block parser", reader->name, input, "call %i: segment info differs", call);
+            matched = false;
+        } else if(refRead && againstBlocks && refParser.newSegmentFlag != liveParser.newSegmentFlag) {
+            reportMismatch("block parser", reader->name, input, "call %i: segment start differs", call);
+            matched = false;
+        } else if(refRead && reader->version == 4 && !againstBlocks &&
+                  refParser.sizesInBlock != liveParser.sizesInBlock) {
+            reportMismatch("block parser", reader->name, input, "call %i: sizes in block differ", call);
+            matched = false;
+        }
+
+        if(refRead) {
+            free(refParser.blockData);
+        }
+
+        if(liveRead) {
+            free(liveParser.blockData);
+        }
+
+        if(!refRead || !liveRead) {
+            break;
+        }
+    }
+
+    reportResult(matched);
+
+    for(int i = 0; i < numBlocks; i++) {
+        free(blocks[i]);
+    }
+
+    free(refParser.blockSizes);
+    free(liveParser.blockSizes);
+    fclose(refFile);
+    fclose(liveFile);
+    free(container.data);
+}
+
+// Refpack data decompressing to exactly size bytes. Only the commands shared by every fibfile version are used.
+static void appendRefpack(uint64_t *state, uint32_t size, byteBuffer *out) {
+    uint8_t literals[112];
+    uint32_t produced = 0;
+
+    while(size - produced >= 4) {
+        const uint32_t remaining = size - produced;
+
+        if(produced && randomBelow(state, 2)) {
+            const uint32_t literalLength = randomBelow(state, remaining - 3 < 4 ? remaining - 3 : 4);
+            const uint32_t copyLimit = remaining - literalLength - 3;
+            const uint32_t copyLength = 4 + randomBelow(state, copyLimit < 64 ? copyLimit : 64);
+            const uint32_t offsetLimit = produced + literalLength;
+            const uint32_t copyOffset = randomBelow(state, offsetLimit < 0x4000 ? offsetLimit : 0x4000);
+            const uint8_t command[3] = {0x80 | (copyLength - 4), (literalLength << 6) | (copyOffset >> 8),
+                                        copyOffset & 0xFF};
+
+            appendBytes(out, command, 3);
+            fillRandom(state, literals, literalLength);
+            appendBytes(out, literals, literalLength);
+            produced += literalLength + copyLength;
+        } else {
+            const uint32_t literalLength = 4 * (1 + randomBelow(state, remaining / 4 < 28 ? remaining / 4 : 28));
+            const uint8_t command = 0xE0 | ((literalLength - 4) >> 2);
+
+            appendBytes(out, &command, 1);
+            fillRandom(state, literals, literalLength);
+            appendBytes(out, literals, literalLength);
+            produced += literalLength;
+        }
+    }
+
+    const uint8_t command = 0xFC | (size - produced);
+
+    appendBytes(out, &command, 1);
+    fillRandom(state, literals, size - produced);
+    appendBytes(out, literals, size - produced);
+}
+
+// Builds a fibfile holding one entry per hash, which have to be in ascending order. Entries are uncompressed or
+// refpacked, and before version 3 each chunk of a compressed entry may be stored literally instead.
+// Entries span up to maxChunks chunks, so 0 leaves them all empty.
+static void buildFibfile(uint64_t *state, enum fibVersion version, const uint32_t *hashes, uint32_t numEntries,
+                         uint32_t maxChunks, byteBuffer *out) {
+    fibEntry entries[MAX_FIB_ENTRIES];
+
+    out->length = 0;
+    appendBytes(out, "FUSE1.00", 8);
+    appendWord(out, numEntries);
+    appendWord(out, 0);
+    appendWord(out, 0); // Filetable offset, filled in once the entries are written
+
+    for(uint32_t i = 0; i < numEntries; i++) {
+        const uint32_t chunkShift = version >= FIB_V3 ? randomBelow(state, 2) : 0;
+        const uint32_t chunkSize = 0x8000 << chunkShift;
+        const uint32_t size = randomBelow(state, maxChunks * chunkSize + 1);
+        const bool compressed = randomBelow(state, 4);
+
+        entries[i].hash = hashes[i];
+        entries[i].offset = out->length;
+
+        if(version >= FIB_V3) {
+            entries[i].flagSize = (size << 5) | (chunkShift << 2) | compressed;
+        } else {
+            entries[i].flagSize = size | (compressed << 30);
+        }
+
+        for(uint32_t chunkStart = 0; chunkStart < size; chunkStart += chunkSize) {
+            const uint32_t chunkLength = size - chunkStart < chunkSize ? size - chunkStart : chunkSize;
+            const uint32_t compression = !compressed ? 0 : version >= FIB_V3 ? 1 : randomBelow(state, 3);
+            uint8_t *chunkData;
+
+            if(compressed) {
+                appendWord(out, 0); // Chunk header, filled in once the chunk is written
+            }
+
+            const size_t headerEnd = out->length;
+
+            if(compression == 1) {
+                appendRefpack(state, chunkLength, out);
+            } else {
+                chunkData = malloc(chunkLength);
+                fillRandom(state, chunkData, chunkLength);
+                appendBytes(out, chunkData, chunkLength);
+                free(chunkData);
+            }
+
+            if(compressed) {
+                uint32_t chunkHeader = out->length - headerEnd;
+
+                if(version < FIB_V3) {
+                    chunkHeader |= compression << 30;
+                }
+
+                memcpy(out->data + headerEnd - 4, &chunkHeader, 4);
+            }
+        }
+    }
+
+    const uint32_t filetableOffset = out->length;
+
+    memcpy(out->data + 0x10, &filetableOffset, 4);
+    appendBytes(out, entries, numEntries * sizeof(fibEntry));
+}
+
+// fibOpen only takes paths, so generated fibfiles go through a temporary file. Returns false if it couldn't be
+// written, otherwise path holds a file the caller has to unlink.
+static bool writeTemporary(const byteBuffer *data, char *path) {
+    strcpy(path, "/tmp/verifyDecodeXXXXXX");
+
+    const int fd = mkstemp(path);
+
+    if(fd < 0) {
+        return false;
+    }
+
+    const bool written = write(fd, data->data, data->length) == (ssize_t) data->length;
+
+    close(fd);
+
+    if(!written) {
+        unlink(path);
+    }
+
+    return written;
+}
+
+// Reads random ranges of a randomized fibfile through a fibReader, comparing them with the whole entries.
+// The reader's cache is sometimes smaller than a chunk, so uncacheable chunks get read too.
+static void checkFibReader(uint64_t *state, int iteration) {
+    char input[48];
+    snprintf(input, sizeof(input), "random fibfile %i", iteration);
+
+    static const enum fibVersion versions[] = {FIB_V1, FIB_V2, FIB_V2_5, FIB_V3, FIB_V3_5};
+    const enum fibVersion version = versions[iteration % NUM_VARIANTS(versions)];
+    const uint32_t numEntries = 1 + randomBelow(state, MAX_FIB_READER_ENTRIES);
+    uint32_t hashes[MAX_FIB_READER_ENTRIES];
+
+    for(uint32_t i = 0; i < numEntries; i++) {
+        hashes[i] = i;
+    }
+
+    byteBuffer fibfile;
+    memset(&fibfile, 0, sizeof(fibfile));
+    buildFibfile(state, version, hashes, numEntries, MAX_FIB_ENTRY_CHUNKS, &fibfile);
+
+    char path[32];
+    fibArchive archive;
+
+    if(!writeTemporary(&fibfile, path)) {
+        free(fibfile.data);
+        return;
+    }
+
+    const bool opened = fibOpen(&archive, path, version);
+
+    unlink(path);
+    free(fibfile.data);
+
+    if(!opened) {
+        reportMismatch("fibfile reader", "fibOpen", input, "couldn't open the generated fibfile");
+        reportResult(false);
+        return;
+    }
+
+    uint8_t *entryData[MAX_FIB_READER_ENTRIES];
+    uint32_t entryLengths[MAX_FIB_READER_ENTRIES];
+    bool matched = true;
+
+    for(uint32_t i = 0; i < numEntries; i++) {
+        entryData[i] = fibReadEntry(&archive, &archive.hashedTable[i], &entryLengths[i]);
+
+        if(!entryData[i]) {
+            reportMismatch("fibfile reader", "fibReadEntry", input, "entry %u couldn't be read", i);
+            matched = false;
+        }
+    }
+
+    fibReader reader;
+    memset(&reader, 0, sizeof(reader));
+
+    if(matched && !fibReaderInit(&reader, &archive, 0x8000 * randomBelow(state, 4))) {
+        matched = false;
+    }
+
+    for(int i = 0; i < FIB_READS && matched; i++) {
+        const uint32_t entry = randomBelow(state, numEntries);
+        const uint32_t entryLength = entryLengths[entry];
+        const uint32_t offset = randomBelow(state, entryLength + 16);
+        const uint32_t length = randomBelow(state, entryLength + 16);
+        const uint32_t expectedLength = offset >= entryLength ? 0 :
+                                        length < entryLength - offset ? length : entryLength - offset;
+        uint8_t *actual = malloc(length + 1);
+        uint32_t bytesRead;
+
+        if(!fibRead(&reader, &archive.hashedTable[entry], offset, length, actual, &bytesRead)) {
+            reportMismatch("fibfile reader", "fibRead", input, "entry %u: 0x%X bytes at 0x%X failed", entry, length,
+                           offset);
+            matched = false;
+        } else if(bytesRead != expectedLength) {
+            reportMismatch("fibfile reader", "fibRead", input, "entry %u: 0x%X bytes at 0x%X read 0x%X, expected 0x%X",
+                           entry, length, offset, bytesRead, expectedLength);
+            matched = false;
+        } else if(bytesRead && memcmp(entryData[entry] + offset, actual, bytesRead)) {
+            reportMismatch("fibfile reader", "fibRead", input, "entry %u: 0x%X bytes at 0x%X differ", entry, length,
+                           offset);
+            matched = false;
+        }
+
+        free(actual);
+    }
+
+    if(reader.archive) {
+        fibReaderDestroy(&reader);
+    }
+
+    reportResult(matched);
+
+    for(uint32_t i = 0; i < numEntries; i++) {
+        free(entryData[i]);
+    }
+
+    fibClose(&archive);
+}
+
+// Mounts randomized fibfiles whose hashes overlap, checking the merged table is ordered by hash then fibfile and
+// that every hash resolves to the entry in the earliest fibfile holding it
+static void checkFibMount(uint64_t *state, int iteration) {
+    char input[48];
+    snprintf(input, sizeof(input), "random mount %i", iteration);
+
+    const enum fibVersion version = randomBelow(state, 2) ? FIB_V2 : FIB_V3;
+    const uint32_t numFibfiles = 1 + randomBelow(state, MAX_MOUNTED_FIBFILES);
+    char paths[MAX_MOUNTED_FIBFILES][32];
+    const char *pathList[MAX_MOUNTED_FIBFILES];
+    uint32_t totalEntries = 0;
+    uint32_t written = 0;
+
+    byteBuffer fibfile;
+    memset(&fibfile, 0, sizeof(fibfile));
+
+    // Every hash is drawn from the same small range, so most of them show up in several fibfiles
+    for(; written < numFibfiles; written++) {
+        uint32_t hashes[MAX_FIB_ENTRIES];
+        uint32_t numEntries = 0;
+
+        for(uint32_t hash = 0; hash < MAX_FIB_ENTRIES; hash++) {
+            if(randomBelow(state, 2)) {
+                hashes[numEntries++] = hash;
+            }
+        }
+
+        buildFibfile(state, version, hashes, numEntries, 0, &fibfile);
+        totalEntries += numEntries;
+        pathList[written] = paths[written];
+
+        if(!writeTemporary(&fibfile, paths[written])) {
+            break;
+        }
+    }
+
+    free(fibfile.data);
+
+    fibMount mount;
+    const bool opened = written == numFibfiles && fibMountOpen(&mount, pathList, numFibfiles, version);
+
+    for(uint32_t i = 0; i < written; i++) {
+        unlink(paths[i]);
+    }
+
+    if(written < numFibfiles) {
+        return;
+    }
+
+    if(!opened) {
+        reportMismatch("fibfile mount", "fibMountOpen", input, "couldn't mount the generated fibfiles");
+        reportResult(false);
+        return;
+    }
+
+    bool matched = true;
+
+    if(mount.entryCount != totalEntries) {
+        reportMismatch("fibfile mount", "fibMountOpen", input, "%u entries merged, expected %u", mount.entryCount,
+                       totalEntries);
+        matched = false;
+    }
+
+    for(uint32_t i = 0; i < mount.entryCount && matched; i++) {
+        const fibMountEntry *entry = &mount.entries[i];
+        const fibArchive *archive = &mount.archives[entry->archiveIndex];
+
+        if(entry->entry < archive->hashedTable || entry->entry >= archive->hashedTable + archive->hashedEntries ||
+           entry->entry->hash != entry->hash) {
+            reportMismatch("fibfile mount", "fibMountOpen", input, "entry %u doesn't point into its fibfile", i);
+            matched = false;
+        } else if(i && (entry[-1].hash > entry->hash ||
+                        (entry[-1].hash == entry->hash && entry[-1].archiveIndex >= entry->archiveIndex))) {
+            reportMismatch("fibfile mount", "fibMountOpen", input, "entry %u (%08X in %u) is out of order", i,
+                           entry->hash, entry->archiveIndex);
+            matched = false;
+        }
+    }
+
+    // One past the range too, which no fibfile holds
+    for(uint32_t hash = 0; hash <= MAX_FIB_ENTRIES && matched; hash++) {
+        const fibEntry *expected = NULL;
+        uint32_t expectedArchive = 0;
+
+        for(; expectedArchive < numFibfiles && !expected; expectedArchive++) {
+            expected = fibFindHash(&mount.archives[expectedArchive], hash);
+        }
+
+        const fibMountEntry *actual = fibMountFindHash(&mount, hash);
+        const bool sameEntry = actual && actual->entry == expected && actual->archiveIndex == expectedArchive - 1;
+
+        if(!expected != !actual || (actual && !sameEntry)) {
+            reportMismatch("fibfile mount", "fibMountFindHash", input, "%08X resolved to fibfile %i, expected %i", hash,
+                           actual ? (int) actual->archiveIndex : -1, expected ? (int) expectedArchive - 1 : -1);
+            matched = false;
+        }
+    }
+
+    reportResult(matched);
+    fibMountClose(&mount);
+}
+
+// A version 2 fibfile with namedData at namedPath in its named filetable, and if given, hashedData under hash in
+// its hashed filetable. Both entries are stored uncompressed.
+static void buildNamedFibfile(const byteBuffer *namedData, const char *namedPath, const byteBuffer *hashedData,
+                              uint32_t hash, byteBuffer *out) {
+    const uint32_t pathSize = strlen(namedPath) + 1;
+    fibEntry entries[2];
+    uint32_t numEntries = 0;
+
+    out->length = 0;
+    appendBytes(out, "FUSE1.00", 8);
+    appendWord(out, hashedData != NULL);
+    appendWord(out, 1);
+    appendWord(out, 0); // Filetable offset, filled in once the entries are written
+
+    if(hashedData) {
+        entries[numEntries].hash = hash;
+        entries[numEntries].offset = out->length;
+        entries[numEntries++].flagSize = hashedData->length;
+        appendBytes(out, hashedData->data, hashedData->length);
+    }
+
+    entries[numEntries].hash = pathSize;
+    entries[numEntries].offset = out->length;
+    entries[numEntries++].flagSize = namedData->length;
+    appendBytes(out, namedData->data, namedData->length);
+
+    const uint32_t filetableOffset = out->length;
+
+    memcpy(out->data + 0x10, &filetableOffset, 4);
+    appendBytes(out, entries, numEntries * sizeof(fibEntry));
+    appendBytes(out, namedPath, pathSize);
+}
+
+// A random version 2 BTGA the reference decodes, along with its pixels
+static void genDecodableBTGA(uint64_t *state, byteBuffer *out, dsBTGAHeader *header, uint32_t **imageData) {
+    for(;;) {
+        genRandomBTGA(state, 2, out);
+
+        FILE *inputFile = fmemopen(out->data, out->length, "rb");
+
+        if(inputFile && !refDecodeTGA(inputFile, &refReadV1Block, 0, header, imageData)) {
+            return;
+        }
+    }
+}
+
+// Reads a line of a reply, without its newline
+static bool readReplyLine(int fd, char *line, size_t capacity) {
+    for(size_t length = 0; length + 1 < capacity; length++) {
+        if(read(fd, &line[length], 1) != 1) {
+            return false;
+        }
+
+        if(line[length] == '\n') {
+            line[length] = '\0';
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Sends one request, and checks the reply is either the expected image or, without one, the expected error
+static bool checkDaemonReply(int fd, const char *request, const dsBTGAHeader *header, const uint32_t *expected,
+                             const char *expectedError, const char *input) {
+    char reply[128];
+
+    if(dprintf(fd, "%s\n", request) != (int) strlen(request) + 1 || !readReplyLine(fd, reply, sizeof(reply))) {
+        reportMismatch("daemon", "convTGA", input, "no reply to %s", request);
+        return false;
+    }
+
+    if(!expected) {
+        if(strncmp(reply, "ERR ", 4) || strcmp(reply + 4, expectedError)) {
+            reportMismatch("daemon", "convTGA", input, "expected ERR %s to %s, got %s", expectedError, request, reply);
+            return false;
+        }
+
+        return true;
+    }
+
+    unsigned int hres;
+    unsigned int vres;
+
+    if(sscanf(reply, "OK %u %u", &hres, &vres) != 2 || hres != header->hres || vres != header->vres) {
+        reportMismatch("daemon", "convTGA", input, "expected a %ux%u image to %s, got %s", header->hres,
+                       header->vres, request, reply);
+        return false;
+    }
+
+    const size_t imageLength = (size_t) hres * vres * 4;
+    uint32_t *actual = malloc(imageLength);
+    size_t received = 0;
+
+    while(received < imageLength) {
+        const ssize_t chunk = read(fd, (uint8_t *) actual + received, imageLength - received);
+
+        if(chunk <= 0) {
+            break;
+        }
+
+        received += chunk;
+    }
+
+    bool matched = received == imageLength;
+
+    if(!matched) {
+        reportMismatch("daemon", "convTGA", input, "image reply to %s cut short", request);
+    } else {
+        matched = comparePixels("daemon", "convTGA", input, expected, actual, hres, hres * vres);
+    }
+
+    free(actual);
+
+    return matched;
+}
+
+// Connects to the daemon, giving it a couple of seconds to start listening. Returns the connection, or -1.
+static int connectDaemon(const struct sockaddr_un *address) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    for(int attempt = 0; fd >= 0 && attempt < 100; attempt++) {
+        if(!connect(fd, (const struct sockaddr *) address, sizeof(*address))) {
+            return fd;
+        }
+
+        usleep(20000);
+    }
+
+    if(fd >= 0) {
+        close(fd);
+    }
+
+    return -1;
+}
+
+// Serves a named filetable entry from a fibfile whose hashed filetable holds either nothing or a different texture
+// under the same path's hash. NAME has to resolve to the named entry and HASH to the hashed one, whichever of them
+// was cached first.
+static void checkDaemon(uint64_t *state, const char *convTGAPath) {
+    char directory[] = "/tmp/verifyDecodeXXXXXX";
+
+    if(!mkdtemp(directory)) {
+        return;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s/socket", directory);
+
+    const pid_t daemon = fork();
+
+    if(!daemon) {
+        const int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        execl(convTGAPath, convTGAPath, "serve", "2", "2", address.sun_path, "16", (char *) NULL);
+        _exit(127);
+    }
+
+    for(int round = 0; round < DAEMON_ROUNDS && daemon > 0; round++) {
+        char input[32];
+        snprintf(input, sizeof(input), "daemon round %i", round);
+
+        // A fresh connection each round, so a reply left unread after a mismatch can't spill into the next round
+        const int fd = connectDaemon(&address);
+
+        if(fd < 0) {
+            reportMismatch("daemon", "convTGA", input, "couldn't connect to %s", convTGAPath);
+            reportResult(false);
+            break;
+        }
+
+        byteBuffer named;
+        byteBuffer hashed;
+        byteBuffer fibfile;
+        memset(&named, 0, sizeof(named));
+        memset(&hashed, 0, sizeof(hashed));
+        memset(&fibfile, 0, sizeof(fibfile));
+
+        dsBTGAHeader namedHeader;
+        dsBTGAHeader hashedHeader;
+        uint32_t *namedImage;
+        uint32_t *hashedImage = NULL;
+        const bool withHashed = round % 2;
+        char namedPath[32];
+
+        snprintf(namedPath, sizeof(namedPath), "textures/named%i.btga", round);
+        genDecodableBTGA(state, &named, &namedHeader, &namedImage);
+
+        if(withHashed) {
+            genDecodableBTGA(state, &hashed, &hashedHeader, &hashedImage);
+        }
+
+        const uint32_t hash = fibHashPath(namedPath);
+        char path[32];
+
+        buildNamedFibfile(&named, namedPath, withHashed ? &hashed : NULL, hash, &fibfile);
+
+        if(writeTemporary(&fibfile, path)) {
+            char nameRequest[96];
+            char hashRequest[64];
+            char longHashRequest[64];
+
+            snprintf(nameRequest, sizeof(nameRequest), "NAME\t%s\t%s", path, namedPath);
+            snprintf(hashRequest, sizeof(hashRequest), "HASH\t%s\t%08X", path, hash);
+            snprintf(longHashRequest, sizeof(longHashRequest), "HASH\t%s\t1%08X", path, hash);
+
+            // Whichever entry is cached first mustn't be served for the other request
+            const bool hashFirst = round / 2 % 2;
+            bool matched = true;
+
+            for(int i = 0; i < 3 && matched; i++) {
+                if((i % 2) != hashFirst) {
+                    matched = checkDaemonReply(fd, hashRequest, &hashedHeader, hashedImage,
+                                               "No such entry in fibfile!", input);
+                } else {
+                    matched = checkDaemonReply(fd, nameRequest, &namedHeader, namedImage, NULL, input);
+                }
+            }
+
+            reportResult(matched && checkDaemonReply(fd, longHashRequest, NULL, NULL, "Malformed hash!", input));
+            unlink(path);
+        }
+
+        close(fd);
+        free(namedImage);
+        free(hashedImage);
+        free(named.data);
+        free(hashed.data);
+        free(fibfile.data);
+    }
+
+    if(daemon > 0) {
+        kill(daemon, SIGTERM);
+        waitpid(daemon, NULL, 0);
+    }
+
+    unlink(address.sun_path);
+    rmdir(directory);
+}
+
+static FILE *openInput(enum inputPath path, const char *filePath, uint8_t *data, size_t length) {
+    if(path == INPUT_MEMORY) {
+        return fmemopen(data, length, "rb");
+    }
+
+    if(filePath) {
+        return fopen(filePath, "rb");
+    }
+
+    FILE *file = tmpfile();
+
+    if(file) {
+        fwrite(data, 1, length, file);
+        rewind(file);
+    }
+
+    return file;
+}
+
+// Decodes one file through the reference and every input path
+static void checkFile(corpusFile *file) {
+    char input[48];
+    const char *inputName = file->path;
+    uint8_t *data;
+    size_t length;
+    byteBuffer generated;
+    memset(&generated, 0, sizeof(generated));
+
+    if(file->path) {
+        int fd = open(file->path, O_RDONLY);
+        struct stat fileInfo;
+
+        if(fd < 0 || fstat(fd, &fileInfo) || !S_ISREG(fileInfo.st_mode) || !fileInfo.st_size) {
+            if(fd >= 0) {
+                close(fd);
+            }
+
+            return;
+        }
+
+        length = fileInfo.st_size;
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if(data == MAP_FAILED) {
+            return;
+        }
+    } else {
+        uint64_t state = file->seed;
+        genRandomBTGA(&state, file->version, &generated);
+
+        data = generated.data;
+        length = generated.length;
+
+        snprintf(input, sizeof(input), "random file (version %i, seed %llu)", file->version,
+                 (unsigned long long) file->seed);
+        inputName = input;
+    }
+
+    long startOffset;
+    bool (*readBlock)(blockParser *, FILE *, long);
+    bool (*refReadBlock)(blockParser *, FILE *, long);
+    char version[2] = {'0' + file->version, '\0'};
+
+    selectBlockReader(version, &readBlock, &startOffset);
+    refReadBlock = readBlock == &readV1Block ? &refReadV1Block :
+                   readBlock == &readV3Block ? &refReadV3Block : &refReadV4Block;
+
+    FILE *refFile = fmemopen(data, length, "rb");
+    dsBTGAHeader refHeader;
+    uint32_t *expected = NULL;
+    char *refError = refFile ? refDecodeTGA(refFile, refReadBlock, startOffset, &refHeader, &expected) : NULL;
+
+    if(!refFile) {
+        free(generated.data);
+        return;
+    }
+
+    for(int run = 0; run < NUM_INPUT_PATHS * NUM_VARIANTS(paletteSources); run++) {
+        const int path = run % NUM_INPUT_PATHS;
+        const paletteSource *source = &paletteSources[run / NUM_INPUT_PATHS];
+        FILE *inputFile = openInput(path, file->path, data, length);
+
+        if(!inputFile) {
+            continue;
+        }
+
+        char variant[48];
+        snprintf(variant, sizeof(variant), "%s, %s", inputPathNames[path], source->name);
+
+        dsBTGAHeader header;
+        uint32_t *actual = NULL;
+        char *error = decodeTGA(inputFile, readBlock, startOffset, source->cache, &header, &actual);
+        bool matched = true;
+
+        if(!refError != !error || (refError && strcmp(refError, error))) {
+            const char *expectedResult = refError ? refError : "success";
+            const char *actualResult = error ? error : "success";
+
+            reportMismatch("file decode", variant, inputName, "expected \"%.*s\", got \"%.*s\"",
+                           (int) strcspn(expectedResult, "\n"), expectedResult,
+                           (int) strcspn(actualResult, "\n"), actualResult);
+            matched = false;
+        } else if(!refError && (refHeader.hres != header.hres || refHeader.vres != header.vres)) {
+            reportMismatch("file decode", variant, inputName, "expected %ux%u, got %ux%u",
+                           refHeader.hres, refHeader.vres, header.hres, header.vres);
+            matched = false;
+        } else if(!refError) {
+            matched = comparePixels("file decode", variant, inputName, expected, actual,
+                                    header.hres, header.hres * header.vres);
+        }
+
+        reportResult(matched);
+        free(actual);
+    }
+
+    free(expected);
+
+    if(file->path) {
+        munmap(data, length);
+    } else {
+        free(generated.data);
+    }
+}
+
+static void *checkFiles(void *arg) {
+    corpus *files = arg;
+
+    while(1) {
+        pthread_mutex_lock(&files->lock);
+        int fileIndex = files->nextFile++;
+        pthread_mutex_unlock(&files->lock);
+
+        if(fileIndex >= files->numFiles) {
+            break;
+        }
+
+        checkFile(&files->files[fileIndex]);
+    }
+
+    return NULL;
+}
+
+static void addFile(corpus *files, char *path, int version, uint64_t seed) {
+    files->files = realloc(files->files, sizeof(corpusFile) * (files->numFiles + 1));
+    files->files[files->numFiles].path = path;
+    files->files[files->numFiles].version = version;
+    files->files[files->numFiles].seed = seed;
+    files->numFiles++;
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = 1000;
+    uint64_t seed = 1;
+    int numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *convTGAPath = NULL;
+    int arg = 1;
+
+    for(; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+        if(!strcmp(argv[arg], "-n")) {
+            iterations = atoi(argv[arg + 1]);
+        } else if(!strcmp(argv[arg], "-s")) {
+            seed = strtoull(argv[arg + 1], NULL, 10);
+        } else if(!strcmp(argv[arg], "-j")) {
+            numThreads = atoi(argv[arg + 1]);
+        } else if(!strcmp(argv[arg], "-d")) {
+            convTGAPath = argv[arg + 1];
+        } else {
+            break;
+        }
+    }
+
+    if((argc - arg) % 2 || iterations < 0) {
+        printf("Format: ./verifyDecode [-n iterations] [-s seed] [-j threads] [-d convTGA] [version input_directory]...\n"
+               "Where version is one of 1, 2, 3, or 4\n");
+        return -1;
+    }
+
+    if(numThreads < 1) {
+        numThreads = 1;
+    } else if(numThreads > MAX_THREADS) {
+        numThreads = MAX_THREADS;
+    }
+
+    if(!paletteCacheInit(&sharedPalettes, SHARED_PALETTE_BYTES)) {
+        return -1;
+    }
+
+    // Seed 0 would leave xorshift stuck at 0
+    uint64_t state = seed ? seed : 1;
+
+    for(int i = 0; i < iterations; i++) {
+        checkKernels(&state, i);
+    }
+
+    for(int i = 0; i < iterations; i++) {
+        checkBlockReader(&state, &blockReaders[i % NUM_VARIANTS(blockReaders)], i);
+    }
+
+    for(int i = 0; i < iterations; i++) {
+        checkFibReader(&state, i);
+    }
+
+    for(int i = 0; i < iterations; i++) {
+        checkFibMount(&state, i);
+    }
+
+    if(convTGAPath) {
+        checkDaemon(&state, convTGAPath);
+    }
+
+    corpus files;
+    memset(&files, 0, sizeof(files));
+    pthread_mutex_init(&files.lock, NULL);
+
+    for(int i = 0; i < iterations; i++) {
+        addFile(&files, NULL, 1 + i % 4, nextRandom(&state) | ((uint64_t) nextRandom(&state) << 32) | 1);
+    }
+
+    for(; arg < argc; arg += 2) {
+        long startOffset;
+        bool (*readBlock)(blockParser *, FILE *, long);
+
+        if(!selectBlockReader(argv[arg], &readBlock, &startOffset)) {
+            printf("Where version is one of 1, 2, 3, or 4\n");
+            return -1;
+        }
+
+        DIR *inputDir = opendir(argv[arg + 1]);
+
+        if(!inputDir) {
+            printf("Unable to open input directory!\n");
+            return -1;
+        }
+
+        struct dirent *currentEntry;
+
+        while((currentEntry = readdir(inputDir))) {
+            char *subfilePath = malloc(strlen(argv[arg + 1]) + strlen(currentEntry->d_name) + 2);
+
+            strcpy(subfilePath, argv[arg + 1]);
+            strcat(subfilePath, "/");
+            strcat(subfilePath, currentEntry->d_name);
+
+            addFile(&files, subfilePath, argv[arg][0] - '0', 0);
+        }
+
+        closedir(inputDir);
+    }
+
+    pthread_t threads[MAX_THREADS];
+
+    for(int i = 0; i < numThreads; i++) {
+        pthread_create(&threads[i], NULL, &checkFiles, &files);
+    }
+
+    for(int i = 0; i < numThreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for(int i = 0; i < files.numFiles; i++) {
+        free(files.files[i].path);
+    }
+
+    free(files.files);
+    pthread_mutex_destroy(&files.lock);
+    paletteCacheDestroy(&sharedPalettes);
+
+    printf("%i checks, %i mismatches (seed %llu)\n", checksRun, mismatches, (unsigned long long) seed);
+
+    return mismatches ? 1 : 0;
+}